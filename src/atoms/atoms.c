@@ -0,0 +1,279 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../includes/atoms.h"
+#include "../includes/errors.h"
+#include "../includes/tokens.h"
+
+#define ATOM_INITIAL_SLOTS 256
+#define ATOM_INITIAL_POOL 4096
+
+static const char *predefinedNames[ATOM_PREDEFINED_COUNT] = {
+	[ATOM_NONE] = "",
+
+	// keywords, at the same values as Keyword:
+	[KEYWORD_PROGRAM] = RESERVED_WORD_PROGRAM,
+	[KEYWORD_VAR] = RESERVED_WORD_VAR,
+	[KEYWORD_BEGIN] = RESERVED_WORD_BEGIN,
+	[KEYWORD_END] = RESERVED_WORD_END,
+	[KEYWORD_IF] = RESERVED_WORD_IF,
+	[KEYWORD_ELSE] = RESERVED_WORD_ELSE,
+	[KEYWORD_THEN] = RESERVED_WORD_THEN,
+	[KEYWORD_DO] = RESERVED_WORD_DO,
+	[KEYWORD_WHILE] = RESERVED_WORD_WHILE,
+	[KEYWORD_FOR] = RESERVED_WORD_FOR,
+	[KEYWORD_TO] = RESERVED_WORD_TO,
+	[KEYWORD_DOWNTO] = RESERVED_WORD_DOWNTO,
+	[KEYWORD_REPEAT] = RESERVED_WORD_REPEAT,
+	[KEYWORD_UNTIL] = RESERVED_WORD_UNTIL,
+	[KEYWORD_CASE] = RESERVED_WORD_CASE,
+	[KEYWORD_OF] = RESERVED_WORD_OF,
+	[KEYWORD_FUNCTION] = RESERVED_WORD_FUNCTION,
+	[KEYWORD_PROCEDURE] = RESERVED_WORD_PROCEDURE,
+	[KEYWORD_ARRAY] = RESERVED_WORD_ARRAY,
+	[KEYWORD_RECORD] = RESERVED_WORD_RECORD,
+	[KEYWORD_CONST] = RESERVED_WORD_CONST,
+	[KEYWORD_TYPE] = RESERVED_WORD_TYPE,
+	[KEYWORD_FILE] = RESERVED_WORD_FILE,
+	[KEYWORD_SET] = RESERVED_WORD_SET,
+	[KEYWORD_GOTO] = RESERVED_WORD_GOTO,
+	[KEYWORD_WITH] = RESERVED_WORD_WITH,
+	[KEYWORD_IN] = RESERVED_WORD_IN,
+	[KEYWORD_INTEGER] = RESERVED_TYPE_INTEGER,
+	[KEYWORD_REAL] = RESERVED_TYPE_REAL,
+	[KEYWORD_CHAR] = RESERVED_TYPE_CHAR,
+	[KEYWORD_STRING] = RESERVED_TYPE_STRING,
+	[KEYWORD_DOUBLE] = RESERVED_TYPE_DOUBLE,
+	[KEYWORD_BYTE] = RESERVED_TYPE_BYTE,
+	[KEYWORD_WORD] = RESERVED_TYPE_WORD,
+	[KEYWORD_LONGINT] = RESERVED_TYPE_LONGINT,
+	[KEYWORD_SHORTINT] = RESERVED_TYPE_SHORTINT,
+	[KEYWORD_SINGLE] = RESERVED_TYPE_SINGLE,
+	[KEYWORD_EXTENDED] = RESERVED_TYPE_EXTENDED,
+	[KEYWORD_COMP] = RESERVED_TYPE_COMP,
+	[KEYWORD_CURRENCY] = RESERVED_TYPE_CURRENCY,
+	[KEYWORD_NOT] = RESERVED_OP_NOT,
+	[KEYWORD_AND] = RESERVED_OP_AND,
+	[KEYWORD_OR] = RESERVED_OP_OR,
+	[KEYWORD_MOD] = RESERVED_OP_MOD,
+
+	// symbols:
+	[ATOM_SEM] = SYMBOL_SEM,
+	[ATOM_OPA] = SYMBOL_OPA,
+	[ATOM_CPA] = SYMBOL_CPA,
+	[ATOM_DOT] = SYMBOL_DOT,
+	[ATOM_COM] = SYMBOL_COM,
+	[ATOM_COLON] = SYMBOL_COLON,
+	[ATOM_OBC] = SYMBOL_OBC,
+	[ATOM_CBC] = SYMBOL_CBC,
+
+	// operators:
+	[ATOM_SUM] = OPERATOR_SUM,
+	[ATOM_SUB] = OPERATOR_SUB,
+	[ATOM_MUL] = OPERATOR_MUL,
+	[ATOM_DIV] = OPERATOR_DIV,
+	[ATOM_EQU] = OPERATOR_EQU,
+	[ATOM_LT] = OPERATOR_LT,
+	[ATOM_GT] = OPERATOR_GT,
+	[ATOM_LE] = "<=",
+	[ATOM_GE] = ">=",
+	[ATOM_NE] = "<>",
+	[ATOM_ASSIGNMENT] = OPERATOR_ASSIGNMENT,
+};
+
+static uint32_t hashAtom(const char *text, size_t length);
+static Atom addAtom(AtomTable *atoms, const char *text, size_t length, uint32_t hash);
+static void growSlots(AtomTable *atoms);
+static void *allocateOrExit(void *block, size_t size);
+
+AtomTable *createAtomTable(void)
+{
+	AtomTable *atoms = (AtomTable *)allocateOrExit(NULL, sizeof(AtomTable));
+
+	atoms->capacity = ATOM_INITIAL_SLOTS;
+	atoms->slots = (Atom *)allocateOrExit(NULL, atoms->capacity * sizeof(Atom));
+	atoms->infoCapacity = ATOM_INITIAL_SLOTS / 2;
+	atoms->infos = (AtomInfo *)allocateOrExit(NULL, atoms->infoCapacity * sizeof(AtomInfo));
+	atoms->count = 0;
+	atoms->pools = NULL;
+	atoms->poolCount = 0;
+	atoms->poolSize = 0;
+	atoms->poolCapacity = 0;
+
+	memset(atoms->slots, 0, atoms->capacity * sizeof(Atom));
+
+	// ATOM_NONE owns the empty name but is never placed in the index, so
+	// empty slots can be told apart from it:
+	addAtom(atoms, "", 0, hashAtom("", 0));
+
+	for (Atom atom = ATOM_NONE + 1; atom < ATOM_PREDEFINED_COUNT; atom++)
+		internAtom(atoms, predefinedNames[atom], strlen(predefinedNames[atom]));
+
+	return atoms;
+}
+
+void freeAtomTable(AtomTable *atoms)
+{
+	if (atoms == NULL)
+		return;
+
+	for (size_t pool = 0; pool < atoms->poolCount; pool++)
+		free(atoms->pools[pool]);
+
+	free(atoms->slots);
+	free(atoms->infos);
+	free(atoms->pools);
+	free(atoms);
+}
+
+Atom internAtom(AtomTable *atoms, const char *text, size_t length)
+{
+	uint32_t hash = hashAtom(text, length);
+	size_t mask = atoms->capacity - 1;
+
+	for (size_t slot = hash & mask;; slot = (slot + 1) & mask)
+	{
+		Atom atom = atoms->slots[slot];
+
+		if (atom == ATOM_NONE)
+		{
+			atom = addAtom(atoms, text, length, hash);
+			atoms->slots[slot] = atom;
+
+			// keep the load factor at or below one half:
+			if ((size_t)atoms->count * 2 > atoms->capacity)
+				growSlots(atoms);
+
+			return atom;
+		}
+
+		const AtomInfo *info = &atoms->infos[atom];
+
+		if (info->hash == hash && info->length == length && memcmp(info->name, text, length) == 0)
+			return atom;
+	}
+}
+
+Atom findAtom(const AtomTable *atoms, const char *text, size_t length)
+{
+	uint32_t hash = hashAtom(text, length);
+	size_t mask = atoms->capacity - 1;
+
+	for (size_t slot = hash & mask;; slot = (slot + 1) & mask)
+	{
+		Atom atom = atoms->slots[slot];
+
+		if (atom == ATOM_NONE)
+			return ATOM_NONE;
+
+		const AtomInfo *info = &atoms->infos[atom];
+
+		if (info->hash == hash && info->length == length && memcmp(info->name, text, length) == 0)
+			return atom;
+	}
+}
+
+const char *atomName(const AtomTable *atoms, Atom atom)
+{
+	return atoms->infos[atom].name;
+}
+
+// multiply-xorshift mixing over 8-byte words: names are hashed a word at a
+// time instead of a byte at a time, and every input bit affects the slot bits:
+static uint32_t hashAtom(const char *text, size_t length)
+{
+	uint64_t hash = 0x9E3779B97F4A7C15u ^ ((uint64_t)length * 0xFF51AFD7ED558CCDu);
+	uint64_t word;
+
+	for (; length >= 8; text += 8, length -= 8)
+	{
+		memcpy(&word, text, 8);
+		hash = (hash ^ word) * 0xBF58476D1CE4E5B9u;
+		hash ^= hash >> 31;
+	}
+
+	if (length > 0)
+	{
+		word = 0;
+		memcpy(&word, text, length);
+		hash = (hash ^ word) * 0xBF58476D1CE4E5B9u;
+		hash ^= hash >> 31;
+	}
+
+	hash *= 0x94D049BB133111EBu;
+	hash ^= hash >> 32;
+
+	return (uint32_t)hash;
+}
+
+static Atom addAtom(AtomTable *atoms, const char *text, size_t length, uint32_t hash)
+{
+	if (atoms->count == atoms->infoCapacity)
+	{
+		atoms->infoCapacity *= 2;
+		atoms->infos = (AtomInfo *)allocateOrExit(atoms->infos, atoms->infoCapacity * sizeof(AtomInfo));
+	}
+
+	// a full pool is never moved, so the names handed out stay valid; the
+	// next pool is twice as large:
+	if (atoms->poolSize + length + 1 > atoms->poolCapacity)
+	{
+		atoms->poolCapacity = atoms->poolCapacity ? atoms->poolCapacity * 2 : ATOM_INITIAL_POOL;
+
+		while (length + 1 > atoms->poolCapacity)
+			atoms->poolCapacity *= 2;
+
+		atoms->pools = (char **)allocateOrExit(atoms->pools, (atoms->poolCount + 1) * sizeof(char *));
+		atoms->pools[atoms->poolCount++] = (char *)allocateOrExit(NULL, atoms->poolCapacity);
+		atoms->poolSize = 0;
+	}
+
+	char *name = atoms->pools[atoms->poolCount - 1] + atoms->poolSize;
+	AtomInfo *info = &atoms->infos[atoms->count];
+	info->name = name;
+	info->length = (uint32_t)length;
+	info->hash = hash;
+
+	memcpy(name, text, length);
+	name[length] = END_OF_STRING;
+	atoms->poolSize += length + 1;
+
+	return atoms->count++;
+}
+
+static void growSlots(AtomTable *atoms)
+{
+	size_t capacity = atoms->capacity * 2, mask = capacity - 1;
+	Atom *slots = (Atom *)allocateOrExit(NULL, capacity * sizeof(Atom));
+
+	memset(slots, 0, capacity * sizeof(Atom));
+
+	// the hashes are cached, so only the probing is repeated:
+	for (Atom atom = ATOM_NONE + 1; atom < atoms->count; atom++)
+	{
+		size_t slot = atoms->infos[atom].hash & mask;
+
+		while (slots[slot] != ATOM_NONE)
+			slot = (slot + 1) & mask;
+
+		slots[slot] = atom;
+	}
+
+	free(atoms->slots);
+	atoms->slots = slots;
+	atoms->capacity = capacity;
+}
+
+static void *allocateOrExit(void *block, size_t size)
+{
+	void *grown = realloc(block, size);
+
+	if (grown == NULL)
+	{
+		fprintf(stderr, ERR_MEMORY_ALLOCATION_FAILED);
+		exit(EXIT_FAILURE);
+	}
+
+	return grown;
+}
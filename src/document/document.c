@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../includes/document.h"
+#include "../includes/errors.h"
+
+// puts the text in a new buffer with the same room on both of its sides.
+// The text is the given prefix, followed by the inserted characters and then
+// by the given suffix:
+static void placeText(Document *document, const char *prefix, size_t before, const char *inserted, size_t length, const char *suffix, size_t after)
+{
+	size_t size = before + length + after;
+	size_t capacity = size + size / 4 + 8192;
+	char *buffer = (char *)malloc(capacity);
+
+	if (buffer == NULL)
+	{
+		fprintf(stderr, ERR_MEMORY_ALLOCATION_FAILED);
+		exit(EXIT_FAILURE);
+	}
+
+	char *text = buffer + (capacity - size) / 2;
+
+	memcpy(text, prefix, before);
+	memcpy(text + before, inserted, length);
+	memcpy(text + before + length, suffix, after);
+
+	free(document->buffer);
+	document->buffer = buffer;
+	document->text = text;
+	document->size = size;
+	document->capacity = capacity;
+}
+
+Document *openDocument(const char *path)
+{
+	Source *source = openSource(path);
+
+	if (source == NULL)
+		return NULL;
+
+	Document *document = (Document *)malloc(sizeof(Document));
+
+	if (document == NULL)
+	{
+		fprintf(stderr, ERR_MEMORY_ALLOCATION_FAILED);
+		exit(EXIT_FAILURE);
+	}
+
+	document->buffer = NULL;
+	placeText(document, source->data, source->size, "", 0, "", 0);
+	closeSource(source);
+
+	Source view = {document->text, document->size, 0};
+	document->lexer = createLexer(&view);
+
+	Token token = lexerAnalysisParallel(document->lexer, 1);
+	document->root = token.type == ERROR ? NULL : parseEdit(document->lexer, NULL, 0, 0);
+
+	return document;
+}
+
+int editDocument(Document *document, size_t offset, size_t removed, const char *text, size_t length)
+{
+	if (offset > document->size || removed > document->size - offset)
+		return 0;
+
+	size_t before = offset, after = document->size - offset - removed;
+	size_t head = (size_t)(document->text - document->buffer), tail = document->capacity - head - document->size;
+	char *start = document->text;
+
+	// the shorter side of the edit moves, into the room on its side:
+	if (before < after && length <= removed + head)
+	{
+		start = document->text + removed - length;
+		memmove(start, document->text, before);
+		memcpy(start + offset, text, length);
+	}
+	else if (length <= removed + tail)
+	{
+		memmove(start + offset + length, start + offset + removed, after);
+		memcpy(start + offset, text, length);
+	}
+	else
+	{
+		placeText(document, start, before, text, length, start + offset + removed, after);
+		start = document->text;
+	}
+
+	document->text = start;
+	document->size = before + length + after;
+
+	// tokens only hold offsets, so the lexer is simply pointed at the new text:
+	LexerContext *lexer = document->lexer;
+	lexer->base = document->text;
+	lexer->limit = document->text + document->size;
+	lexer->stop = lexer->limit;
+
+	size_t first, count;
+	Token token = relexEdit(lexer, offset, removed, length, &first, &count);
+
+	// tokens after a lexical error are never read, so the text keeps an
+	// error that lies past the tokens which did not change:
+	if (token.type == ERROR || (document->root == NULL && token.type != END_OF_FILE))
+	{
+		freeNode(document->root);
+		document->root = NULL;
+		return 0;
+	}
+
+	// after a lexical error the tree is built again from all the tokens:
+	document->root = parseEdit(lexer, document->root, first, count);
+
+	return 1;
+}
+
+void closeDocument(Document *document)
+{
+	if (document == NULL)
+		return;
+
+	freeNode(document->root);
+	freeLexer(document->lexer);
+	free(document->buffer);
+	free(document);
+}
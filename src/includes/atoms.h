@@ -0,0 +1,119 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "./lexer.h"
+
+/**
+ * @struct AtomInfo
+ * @brief Describes the name of one atom stored in the string pools.
+ *
+ * @var AtomInfo::name
+ * The NUL-terminated name, inside one of the AtomTable::pools.
+ *
+ * @var AtomInfo::length
+ * The number of characters in the name.
+ *
+ * @var AtomInfo::hash
+ * The hash of the name, kept to avoid rehashing when the slots grow.
+ */
+typedef struct AtomInfo
+{
+    const char *name;
+    uint32_t length;
+    uint32_t hash;
+} AtomInfo;
+
+/**
+ * @struct AtomTable
+ * @brief Interns lexemes, giving each distinct one a 32-bit Atom.
+ *
+ * Names are copied once into string pools and found through an
+ * open-addressing index with linear probing, so memory grows with the number
+ * of distinct lexemes rather than with the number of tokens. Pools are never
+ * reallocated, so a name stays at the same address for the life of the table.
+ *
+ * @var AtomTable::slots
+ * Open-addressing index holding atoms; ATOM_NONE marks empty slots.
+ *
+ * @var AtomTable::capacity
+ * The number of slots, always a power of two.
+ *
+ * @var AtomTable::infos
+ * Name of each atom, indexed by the atom itself.
+ *
+ * @var AtomTable::count
+ * The number of atoms in use, including ATOM_NONE.
+ *
+ * @var AtomTable::pools
+ * The blocks holding the names of all atoms, stored back to back and
+ * NUL-terminated; only the last one receives new names.
+ *
+ * @var AtomTable::poolCount
+ * The number of blocks in AtomTable::pools.
+ *
+ * @var AtomTable::poolSize
+ * The number of bytes used in the last block.
+ *
+ * @var AtomTable::poolCapacity
+ * The size of the last block.
+ */
+typedef struct AtomTable
+{
+    Atom *slots;
+    size_t capacity;
+    AtomInfo *infos;
+    uint32_t count;
+    uint32_t infoCapacity;
+    char **pools;
+    size_t poolCount;
+    size_t poolSize;
+    size_t poolCapacity;
+} AtomTable;
+
+/**
+ * @brief Creates an atom table pre-seeded with the keywords, symbols and
+ *        operators at their fixed atoms.
+ *
+ * @return A pointer to the new table. Exits the program if memory runs out.
+ */
+AtomTable *createAtomTable(void);
+
+/**
+ * @brief Releases an atom table and its string pool.
+ *
+ * @param atoms The table to release. If NULL, the function does nothing.
+ */
+void freeAtomTable(AtomTable *atoms);
+
+/**
+ * @brief Returns the atom of a lexeme, interning it on first sight.
+ *
+ * @param atoms The table in which the lexeme is interned.
+ * @param text The first character of the lexeme; it does not need to be NUL-terminated.
+ * @param length The number of characters in the lexeme.
+ * @return The atom identifying the lexeme.
+ */
+Atom internAtom(AtomTable *atoms, const char *text, size_t length);
+
+/**
+ * @brief Returns the atom of a lexeme without interning it.
+ *
+ * @param atoms The table to search.
+ * @param text The first character of the lexeme.
+ * @param length The number of characters in the lexeme.
+ * @return The atom identifying the lexeme, or ATOM_NONE if it was never interned.
+ */
+Atom findAtom(const AtomTable *atoms, const char *text, size_t length);
+
+/**
+ * @brief Returns the NUL-terminated name of an atom.
+ *
+ * The pointer stays valid until the table is released.
+ *
+ * @param atoms The table holding the atom.
+ * @param atom The atom whose name is requested.
+ * @return The name of the atom.
+ */
+const char *atomName(const AtomTable *atoms, Atom atom);
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "./lexer.h"
+#include "./parser.h"
+#include "./source.h"
+
+/**
+ * @struct Document
+ * @brief Holds a source being edited together with its tokens and tree.
+ *
+ * The text is kept in a buffer of its own, so it can change after the file
+ * it was read from is closed. The buffer has room on both sides of the text,
+ * so an edit only moves the shorter of the parts before and after it. Each
+ * edit then only lexes again the tokens around it and parses again the
+ * smallest run of statements holding them.
+ *
+ * @var Document::buffer
+ * The memory holding the text.
+ *
+ * @var Document::text
+ * The current text, somewhere inside Document::buffer. It is not NUL-terminated.
+ *
+ * @var Document::size
+ * The number of characters of the text.
+ *
+ * @var Document::capacity
+ * The number of characters allocated for Document::buffer.
+ *
+ * @var Document::lexer
+ * The lexer reading the text, whose table holds the tokens of the text.
+ *
+ * @var Document::root
+ * The tree of the tokens, or NULL while the text has a lexical error.
+ */
+typedef struct Document
+{
+    char *buffer;
+    char *text;
+    size_t size;
+    size_t capacity;
+    LexerContext *lexer;
+    ASTNode *root;
+} Document;
+
+/**
+ * @brief Loads a file into a new document, lexing and parsing all of it.
+ *
+ * Syntax errors are reported and end the program as in parseTokens.
+ *
+ * @param path The path of the file to load.
+ * @return The new document, or NULL if the file could not be read.
+ */
+Document *openDocument(const char *path);
+
+/**
+ * @brief Replaces a range of the text of a document and updates its tokens and tree.
+ *
+ * @param document The document to edit.
+ * @param offset The offset of the first character replaced.
+ * @param removed The number of characters replaced.
+ * @param text The characters put in their place, not NUL-terminated.
+ * @param length The number of characters put in their place.
+ * @return Non-zero if the tree is up to date, or zero if the range is out of
+ *         the text or the edited text has a lexical error.
+ */
+int editDocument(Document *document, size_t offset, size_t removed, const char *text, size_t length);
+
+/**
+ * @brief Releases a document with its text, tokens and tree.
+ *
+ * @param document The document to release. If NULL, the function does nothing.
+ */
+void closeDocument(Document *document);
@@ -1,6 +1,11 @@
 #pragma once
 
 #include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "./lines.h"
+#include "./source.h"
 
 /**
  * @file lexer.h
@@ -36,214 +41,557 @@ typedef enum TokenType
     ERROR
 } TokenType;
 
+/**
+ * @brief Finer classification of tokens, stored in one byte per token.
+ *
+ * Each kind determines both the TokenType and the printable name of a token,
+ * so neither needs to be stored with it.
+ */
+typedef enum TokenKind
+{
+    KIND_RESERVED_WORD,
+    KIND_RESERVED_TYPE,
+    KIND_RESERVED_OPERATOR,
+    KIND_IDENTIFIER,
+    KIND_INTEGER,
+    KIND_REAL,
+    KIND_RELATIONAL,
+    KIND_ARITHMETIC,
+    KIND_ASSIGNMENT,
+    KIND_SYMBOL,
+    KIND_STRING,
+    KIND_END_OF_FILE,
+    KIND_ERROR,
+    TOKEN_KIND_COUNT
+} TokenKind;
+
+/**
+ * @brief Identifies each reserved word, type and operator of the language.
+ *
+ * Tokens classified as keywords carry one of these values as their atom, so
+ * keyword checks compare integers and are independent of the letter case used
+ * in the source (Pascal keywords are case-insensitive).
+ */
+typedef enum Keyword
+{
+    KEYWORD_NONE,
+
+    // reserved words:
+    KEYWORD_PROGRAM,
+    KEYWORD_VAR,
+    KEYWORD_BEGIN,
+    KEYWORD_END,
+    KEYWORD_IF,
+    KEYWORD_ELSE,
+    KEYWORD_THEN,
+    KEYWORD_DO,
+    KEYWORD_WHILE,
+    KEYWORD_FOR,
+    KEYWORD_TO,
+    KEYWORD_DOWNTO,
+    KEYWORD_REPEAT,
+    KEYWORD_UNTIL,
+    KEYWORD_CASE,
+    KEYWORD_OF,
+    KEYWORD_FUNCTION,
+    KEYWORD_PROCEDURE,
+    KEYWORD_ARRAY,
+    KEYWORD_RECORD,
+    KEYWORD_CONST,
+    KEYWORD_TYPE,
+    KEYWORD_FILE,
+    KEYWORD_SET,
+    KEYWORD_GOTO,
+    KEYWORD_WITH,
+    KEYWORD_IN,
+
+    // reserved types:
+    KEYWORD_INTEGER,
+    KEYWORD_REAL,
+    KEYWORD_CHAR,
+    KEYWORD_STRING,
+    KEYWORD_DOUBLE,
+    KEYWORD_BYTE,
+    KEYWORD_WORD,
+    KEYWORD_LONGINT,
+    KEYWORD_SHORTINT,
+    KEYWORD_SINGLE,
+    KEYWORD_EXTENDED,
+    KEYWORD_COMP,
+    KEYWORD_CURRENCY,
+
+    // reserved operators:
+    KEYWORD_NOT,
+    KEYWORD_AND,
+    KEYWORD_OR,
+    KEYWORD_MOD,
+
+    KEYWORD_COUNT
+} Keyword;
+
+/**
+ * @brief Integer identifier of an interned lexeme.
+ *
+ * Every distinct lexeme is interned once and referred to by its atom. The
+ * keywords are pre-seeded so that their atoms are equal to their Keyword
+ * values, and the symbols and operators used by the parser follow them at
+ * the fixed values of PredefinedAtom. ATOM_NONE (0) marks tokens without
+ * a lexeme, such as the end of file.
+ */
+typedef uint32_t Atom;
+
+/**
+ * @brief Fixed atoms of the symbols and operators, placed after the keywords.
+ */
+typedef enum PredefinedAtom
+{
+    ATOM_NONE = KEYWORD_NONE,
+
+    // symbols:
+    ATOM_SEM = KEYWORD_COUNT,
+    ATOM_OPA,
+    ATOM_CPA,
+    ATOM_DOT,
+    ATOM_COM,
+    ATOM_COLON,
+    ATOM_OBC,
+    ATOM_CBC,
+
+    // operators:
+    ATOM_SUM,
+    ATOM_SUB,
+    ATOM_MUL,
+    ATOM_DIV,
+    ATOM_EQU,
+    ATOM_LT,
+    ATOM_GT,
+    ATOM_LE,
+    ATOM_GE,
+    ATOM_NE,
+    ATOM_ASSIGNMENT,
+
+    ATOM_PREDEFINED_COUNT
+} PredefinedAtom;
+
+struct AtomTable;
+struct TokenStream;
+
+/**
+ * @struct KeywordEntry
+ * @brief Describes one slot of the perfect hash table of keywords.
+ *
+ * @var KeywordEntry::text
+ * The keyword spelled in lower case.
+ *
+ * @var KeywordEntry::length
+ * The length of the keyword; 0 for empty slots.
+ *
+ * @var KeywordEntry::kind
+ * The token kind assigned to the keyword.
+ *
+ * @var KeywordEntry::keyword
+ * The Keyword value identifying the keyword.
+ */
+typedef struct KeywordEntry
+{
+    const char *text;
+    int length;
+    TokenKind kind;
+    Keyword keyword;
+} KeywordEntry;
+
 /**
  * @struct Token
  * @brief Represents a lexical token.
  *
- * This structure is used to store information about a token identified
- * during lexical analysis.
+ * This structure is a self-contained view of one token: the lexer returns
+ * it and the token stream rebuilds it from its parallel arrays on request.
+ * The lexeme is not copied: the token refers to its position in the source
+ * buffer being analysed. Rows and columns are not stored; tokenPosition
+ * finds them from the offset when they are needed.
  *
  * @var Token::name
  * The name of the token.
  *
- * @var Token::word
- * The actual word or lexeme that the token represents.
- *
- * @var Token::row
- * The row number where the token was found in the source code.
+ * @var Token::offset
+ * The offset of the first character of the lexeme in the source buffer.
  *
- * @var Token::column
- * The column number where the token starts in the source code.
+ * @var Token::length
+ * The number of characters in the lexeme.
  *
  * @var Token::type
  * The type of the token, represented by the TokenType enumeration.
+ *
+ * @var Token::atom
+ * The interned lexeme of the token. For keywords it equals their Keyword value.
+ *
+ * @var Token::kind
+ * The kind of the token, from which its type and name derive.
+ *
+ * @var Token::index
+ * The position of the token in its stream.
  */
 typedef struct Token
 {
     char *name;
-    char *word;
-    int row;
-    int column;
+    size_t offset;
+    size_t length;
     TokenType type;
-    struct Token *next;
+    Atom atom;
+    TokenKind kind;
+    size_t index;
 } Token;
 
 /**
- * @struct Entry
- * @brief Represents an entry in a hash table or linked list.
- *
- * This structure is used to store a key-value pair where the key is a string
- * and the value is a pointer to a Token. Each entry also contains a pointer
- * to the next entry, allowing for the creation of a linked list.
+ * @struct Symbol
+ * @brief Represents one distinct lexeme in the symbol index of a Table.
  *
- * @var Entry::key
- * The key associated with the entry, represented as a string.
+ * @var Symbol::atom
+ * The atom of the lexeme; ATOM_NONE marks an empty slot.
  *
- * @var Entry::token
- * A pointer to the Token associated with the key.
+ * @var Symbol::count
+ * The number of tokens in the table with this lexeme.
  *
- * @var Entry::next
- * A pointer to the next entry in the linked list.
+ * @var Symbol::first
+ * The index of the first token in the table with this lexeme, or TOKEN_NONE
+ * after an edit replaced it, until it is searched for again.
  */
-typedef struct Entry
+typedef struct Symbol
 {
-    char *key;
-    Token *token;
-    struct Entry *next;
-    struct Entry *prev;
-} Entry;
+    Atom atom;
+    uint32_t count;
+    size_t first;
+} Symbol;
 
 /**
  * @struct Table
- * @brief Represents a table containing an array of entries.
+ * @brief Represents the tokens produced by the lexer and the index of their lexemes.
+ *
+ * Tokens are kept in source order in a chunked token stream, while the
+ * distinct lexemes are indexed by an open-addressing hash table with linear
+ * probing that doubles whenever it becomes more than half full, so inserting
+ * and searching take amortized constant time.
+ *
+ * @var Table::tokens
+ * The tokens of the table, in the order produced by the lexer.
+ *
+ * @var Table::symbols
+ * The slots of the symbol index.
  *
- * This structure is used to store a collection of entries, where each entry
- * is a pointer to an Entry object. The entries are stored in a dynamically
- * allocated array.
+ * @var Table::symbolCapacity
+ * The number of slots of the symbol index, always a power of two.
  *
- * @var Table::entries
- * Pointer to an array of Entry pointers. Each element in the array points
- * to an Entry object.
+ * @var Table::symbolCount
+ * The number of distinct lexemes in the symbol index.
+ *
+ * @var Table::atoms
+ * The atoms interned for the lexemes of the tokens in the table.
  */
 typedef struct
 {
-    Entry **entries;
-    int entryCount;
+    struct TokenStream *tokens;
+    Symbol *symbols;
+    size_t symbolCapacity;
+    size_t symbolCount;
+    struct AtomTable *atoms;
 } Table;
 
-FILE *input, *output;
+/**
+ * @struct LexerContext
+ * @brief Holds everything one lexer needs to read one source.
+ *
+ * A lexer keeps no state outside its context, so any number of sources can
+ * be lexed at once, each on its own thread, as long as no context is shared
+ * between threads.
+ *
+ * @var LexerContext::base
+ * The first character of the source; token offsets are relative to it.
+ *
+ * @var LexerContext::cursor
+ * The next character to be read.
+ *
+ * @var LexerContext::limit
+ * The end of the input.
+ *
+ * @var LexerContext::stop
+ * No lexeme begins at or after it; the input ends there once the lexer is
+ * back in q0. It is LexerContext::limit, except in the chunks of the
+ * parallel mode, where a comment may run past the end of its chunk.
+ *
+ * @var LexerContext::lines
+ * The line index of the source, or NULL until a position is first asked for.
+ *
+ * @var LexerContext::report
+ * Non-zero to print lexical errors to stderr.
+ *
+ * @var LexerContext::table
+ * The table where the tokens are stored and their lexemes interned.
+ */
+typedef struct LexerContext
+{
+    const char *base;
+    const char *cursor;
+    const char *limit;
+    const char *stop;
+    LineIndex *lines;
+    int report;
+    Table *table;
+} LexerContext;
 
 /**
- * @brief Creates a new token with the specified attributes.
+ * @brief Builds the view of a token from its kind and position.
+ *
+ * The type and name of the token are derived from its kind; its atom is
+ * ATOM_NONE until the caller sets it.
  *
- * @param type The type of the token.
- * @param name The name of the token.
- * @param word The word associated with the token.
- * @param row The row number where the token is found.
- * @param column The column number where the token is found.
- * @return Token* A pointer to the newly created token.
+ * @param kind The kind of the token.
+ * @param offset The offset of the first character of the lexeme in the source buffer.
+ * @param length The number of characters in the lexeme.
+ * @return The token.
  */
-static Token *createToken(TokenType type, char *name, char *word, int row, int column);
+Token createToken(TokenKind kind, size_t offset, size_t length);
 
 /**
- * @brief Searches for a token in the hash table using the given key.
+ * @brief Searches for the first token with the given lexeme.
  *
- * This function searches for a token in the provided hash table by computing
- * the hash index of the key and then traversing the linked list at that index
- * to find the matching key. If a matching key is found, the corresponding token
- * is returned. If no matching key is found, the function returns NULL.
+ * The key is resolved to its atom and looked up in the symbol index. Keywords
+ * are found whatever letter case the key uses.
  *
- * @param table Pointer to the hash table to search.
- * @param key The key to search for in the hash table.
- * @return Pointer to the token associated with the key, or NULL if the key is not found.
+ * @param table Pointer to the table to search.
+ * @param key The NUL-terminated lexeme to search for.
+ * @return The index of the first token with the lexeme in Table::tokens, or
+ *         TOKEN_NONE if there is none.
  */
-Token *searchTable(Table *table, char *key);
+size_t searchTable(Table *table, const char *key);
 
 /**
- * @brief Inserts a token into the hash table with the given key.
+ * @brief Appends a token to a table and records its lexeme in the symbol index.
  *
- * This function creates a new entry with the specified key and token,
- * computes the hash index for the key, and inserts the entry into the
- * hash table. If there is a collision (i.e., another entry already exists
- * at the computed index), the new entry is added to the end of the linked
- * list at that index.
+ * The token is appended to the token stream of the table, which also sets
+ * Token::index. If its atom is
+ * already in the symbol index, only the occurrence count of the symbol grows;
+ * otherwise a new symbol is added, growing the index first if needed.
  *
- * @param table Pointer to the hash table where the entry will be inserted.
- * @param key The key associated with the token to be inserted.
+ * @param table Pointer to the table where the token will be inserted.
  * @param token Pointer to the token to be inserted into the table.
  */
-static void insertTable(Table *table, char *key, Token *token);
+static void insertTable(Table *table, Token *token);
 
 /**
- * @brief Computes a hash value for a given key.
+ * @brief Finds the slot of an atom in the symbol index.
  *
- * This function takes a string key and computes its hash value using a simple
- * hash function. The hash value is then modded by the table size to ensure it
- * fits within the bounds of the hash table.
+ * @param symbols The slots of the symbol index.
+ * @param capacity The number of slots, a power of two.
+ * @param atom The atom to look for.
+ * @return The slot holding the atom, or the empty slot where it belongs.
+ */
+static Symbol *findSymbol(Symbol *symbols, size_t capacity, Atom atom);
+
+/**
+ * @brief Doubles the number of slots of the symbol index of a table.
  *
- * @param key The string key to be hashed.
- * @param tableSize The size of the hash table.
- * @return The computed hash value modded by the table size.
+ * @param table Pointer to the table whose index grows.
  */
-static unsigned int hash(char *key, int tableSize);
+static void growSymbols(Table *table);
+
+/**
+ * @brief Records occurrences of an atom in the symbol index of a table.
+ *
+ * @param table Pointer to the table whose index is updated.
+ * @param atom The atom of the occurrences.
+ * @param first Index in the token stream of the first occurrence, kept if
+ *              no earlier occurrence is known.
+ * @param count The number of occurrences.
+ */
+static void addSymbol(Table *table, Atom atom, size_t first, uint32_t count);
+
+/**
+ * @brief Replaces a range of tokens of a table, keeping its symbol index up to date.
+ *
+ * @param table Pointer to the table whose tokens are replaced.
+ * @param from The index of the first token replaced.
+ * @param removed The number of tokens replaced.
+ * @param replacement The tokens inserted in their place.
+ * @param offsetDelta The number of bytes the tokens after the range move by.
+ */
+static void spliceTable(Table *table, size_t from, size_t removed, const struct TokenStream *replacement, ptrdiff_t offsetDelta);
 
 /**
  * @brief Initializes a new Table structure.
  *
- * This function allocates memory for a new Table structure and its entries.
- * It sets all entries to NULL and initializes the entry count to 0.
+ * This function allocates memory for a new, empty Table structure together
+ * with its symbol index and atom table.
  *
  * @return A pointer to the newly initialized Table structure.
  */
 Table *initTable();
 
 /**
- * @brief Performs lexical analysis on the input and generates tokens.
+ * @brief Removes all tokens and symbols of a Table.
  *
- * This function reads characters from the input and identifies different types of tokens such as
- * spaces, numeric values, alphanumeric values, symbols, operators, reserved words, identifiers,
- * integer values, real values, relational operators, assignment operators, and strings. It also
- * handles lexical errors and end-of-file conditions.
+ * The table itself stays valid and empty, ready to receive new tokens.
  *
- * @param table A pointer to the symbol table where tokens will be inserted.
- * @return A pointer to the generated token.
+ * @param table A pointer to the Table to be cleared.
  */
-Token *lexerAnalysis(Table *table);
+void clearTable(Table *table);
 
 /**
- * @brief Adds a character to a dynamically allocated word array.
+ * @brief Releases a Table together with all of its tokens and symbols.
  *
- * This function appends a given character to the end of a dynamically
- * allocated word array, resizing the array if necessary.
+ * @param table A pointer to the Table to be released.
+ */
+void freeTable(Table *table);
+
+/**
+ * @brief Creates a lexer that reads from the given source buffer.
  *
- * @param word A pointer to the dynamically allocated word array.
- * @param size A pointer to the current size of the word array.
- * @param ch The character to be added to the word array.
+ * The lexer advances a cursor over the in-memory contents of the source
+ * instead of reading the file one character at a time. It gets an empty
+ * table of its own.
+ *
+ * @param source The loaded source to be analysed. It must outlive the lexer.
+ * @return The new lexer, to be released with freeLexer.
  */
-static void addWord(char **word, int *size, const char ch);
+LexerContext *createLexer(const Source *source);
 
 /**
- * @brief Checks if a given word is a reserved word.
+ * @brief Releases a lexer, its table and its line index.
  *
- * This function compares the input word against a list of reserved words
- * and returns 1 if the word is found in the list, otherwise returns 0.
+ * @param lexer The lexer to be released, or NULL.
+ */
+void freeLexer(LexerContext *lexer);
+
+/**
+ * @brief Returns the lexeme of a token inside the source buffer.
  *
- * @param word The word to be checked.
- * @return int Returns 1 if the word is a reserved word, otherwise returns 0.
+ * The returned characters are not NUL-terminated; use Token::length to
+ * know where the lexeme ends, or tokenWord to obtain a string.
+ *
+ * @param lexer The lexer that read the token.
+ * @param token The token whose lexeme is requested.
+ * @return A pointer to the first character of the lexeme.
+ */
+const char *tokenLexeme(const LexerContext *lexer, const Token *token);
+
+/**
+ * @brief Builds a NUL-terminated copy of the lexeme of a token.
+ *
+ * @param lexer The lexer that read the token.
+ * @param token The token whose lexeme is requested.
+ * @return A newly allocated string that the caller must free, or NULL if
+ *         the allocation failed.
+ */
+char *tokenWord(const LexerContext *lexer, const Token *token);
+
+/**
+ * @brief Finds the row and column of an offset in the source of a lexer.
+ *
+ * The line index of the lexer is built, or extended, on the first call
+ * that needs it; later calls only search it.
+ *
+ * @param lexer The lexer reading the source.
+ * @param offset The offset in the source.
+ * @return The position of the offset.
  */
-static int isReservedWord(const char *word);
+Position sourcePosition(LexerContext *lexer, size_t offset);
 
 /**
- * @brief Checks if a given word is a reserved type.
+ * @brief Finds the row and column of a token.
  *
- * This function takes a string as input and checks if it matches any of the predefined reserved type words.
+ * As in the .lex files, the column of a token is the column of the last
+ * character of its lexeme.
  *
- * @param word The word to check. If NULL, the function returns 0.
- * @return Returns 1 if the word is a reserved type, otherwise returns 0.
+ * @param lexer The lexer that read the token.
+ * @param token The token whose position is requested.
+ * @return The position of the token.
  */
-static int isReservedType(const char *word);
+Position tokenPosition(LexerContext *lexer, const Token *token);
 
 /**
- * @brief Checks if a given word is a reserved operator.
+ * @brief Performs lexical analysis on the input and generates tokens.
+ *
+ * This function runs the table-driven automaton drawn in src/FLAP over the input: each character
+ * is mapped to a character class with one table lookup, and the pair (state, class) selects the
+ * next state and action from a transition table. It identifies spaces, numeric values,
+ * alphanumeric values, symbols, operators, reserved words, identifiers, integer values, real
+ * values, relational operators, assignment operators, and strings. It also handles lexical
+ * errors and end-of-file conditions.
+ *
+ * Every token but the end of file is appended to the table of the lexer. On a lexical error
+ * the error is reported and a token of type ERROR is returned.
  *
- * This function compares the input word against a list of reserved operator words.
- * If the word matches any of the reserved operators, the function returns 1.
- * Otherwise, it returns 0.
+ * @param lexer The lexer to read from.
+ * @return The generated token.
+ */
+Token lexerAnalysis(LexerContext *lexer);
+
+/**
+ * @brief Lexes the rest of the input on several threads.
+ *
+ * The input is split into chunks that begin at the start of a line. As no
+ * lexeme spans a line break, every chunk can be lexed from the initial state
+ * on its own thread, into a table of its own. The chunks are then stitched
+ * into the table in order: offsets are already relative to the whole input,
+ * atoms are interned again in order of first occurrence and symbol counts
+ * are summed, so the table ends up exactly as repeated calls to lexerAnalysis
+ * would leave it. On a lexical error the chunk holding it is lexed again
+ * sequentially, so the same message is reported and the same tokens kept.
+ *
+ * Inputs too small to be worth splitting are lexed on the calling thread.
+ *
+ * @param lexer The lexer to read from.
+ * @param threads The number of threads to use.
+ * @return The last token read, of type END_OF_FILE or ERROR.
+ */
+Token lexerAnalysisParallel(LexerContext *lexer, int threads);
+
+/**
+ * @brief Lexes again the part of the input changed by an edit.
+ *
+ * The table of the lexer holds the tokens of the input as it was before the
+ * edit, while the lexer already reads the edited input. Lexing restarts
+ * after the last token that ends before the edit and stops at the first new
+ * token past the edit that lines up with an old one, since all the tokens
+ * after it are bound to be the same. Only the tokens in between are replaced;
+ * the ones after them are moved by the size of the edit.
+ *
+ * After a lexical error, which is reported as in lexerAnalysis, the table
+ * ends with the tokens read before it.
+ *
+ * @param lexer The lexer whose table is updated.
+ * @param offset The offset in the input where the edit begins.
+ * @param removed The number of characters removed at the offset.
+ * @param inserted The number of characters inserted in their place.
+ * @param first Receives the index of the first token replaced.
+ * @param count Receives the number of tokens put in place of the old ones.
+ * @return The last token read: the first one that did not change, or a
+ *         token of type END_OF_FILE or ERROR.
+ */
+Token relexEdit(LexerContext *lexer, size_t offset, size_t removed, size_t inserted, size_t *first, size_t *count);
+
+/**
+ * @brief Reads the next token without storing it anywhere.
  *
- * @param word The word to check against the list of reserved operators.
- *             If the word is NULL, the function returns 0.
+ * The lexer keeps its position between calls, so a consumer can pull tokens
+ * one at a time as it needs them. Lexical errors are reported as in
+ * lexerAnalysis.
  *
- * @return 1 if the word is a reserved operator, 0 otherwise.
+ * @param lexer The lexer to read from; its lexemes are interned in the atom
+ *              table of its table.
+ * @return The token read, of type END_OF_FILE at the end of the input or
+ *         ERROR after a lexical error.
  */
-static int isReservedOperator(const char *word);
+Token nextToken(LexerContext *lexer);
 
 /**
- * @brief Checks if a given word is a valid identifier.
+ * @brief Classifies a word as a reserved word, type or operator.
  *
- * An identifier is considered valid if it starts with an underscore ('_') or a letter (a-z, A-Z),
- * and is followed by any combination of underscores, letters, or digits (0-9).
+ * The word is hashed on its length and on its first, second and last
+ * characters folded to lower case into a collision-free table, and then
+ * compared once against the keyword found in that slot, ignoring case.
  *
  * @param word The word to be checked.
- * @return int Returns 1 if the word is a valid identifier, 0 otherwise.
+ * @param length The number of characters in the word.
+ * @return The matching keyword entry, or NULL if the word is not a keyword.
  */
-static int isValidIdentifier(const char *word);
\ No newline at end of file
+static const KeywordEntry *findKeyword(const char *word, int length);
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * @struct Position
+ * @brief A row and column in a source, both starting at 1.
+ *
+ * @var Position::row
+ * The row, counting the new lines before the offset.
+ *
+ * @var Position::column
+ * The number of characters, not bytes, from the start of the row up to the
+ * offset.
+ */
+typedef struct Position
+{
+    size_t row;
+    size_t column;
+} Position;
+
+/**
+ * @struct LineIndex
+ * @brief Offsets where the lines of a source begin.
+ *
+ * The index is built on demand, in one pass of the newline scanning kernel,
+ * so lexing never counts rows or columns; an offset is turned into a
+ * Position by a binary search only when a diagnostic or an output needs it.
+ * An index may cover only a prefix of the source, which is extended the next
+ * time a position past it is asked for.
+ *
+ * @var LineIndex::starts
+ * The offset of the first character of each line, in increasing order.
+ * The first line always starts at 0.
+ *
+ * @var LineIndex::count
+ * The number of lines in LineIndex::starts.
+ *
+ * @var LineIndex::capacity
+ * The number of offsets LineIndex::starts can hold.
+ *
+ * @var LineIndex::scanned
+ * The number of characters of the source the index covers.
+ */
+typedef struct LineIndex
+{
+    size_t *starts;
+    size_t count;
+    size_t capacity;
+    size_t scanned;
+} LineIndex;
+
+/**
+ * @brief Creates an index that covers no characters yet.
+ *
+ * @return A pointer to the new index.
+ */
+LineIndex *createLineIndex(void);
+
+/**
+ * @brief Frees an index and its offsets.
+ *
+ * @param lines The index to free. If NULL, the function does nothing.
+ */
+void freeLineIndex(LineIndex *lines);
+
+/**
+ * @brief Extends an index to cover the whole source.
+ *
+ * Only the characters past LineIndex::scanned are read.
+ *
+ * @param lines The index to extend.
+ * @param text The first character of the source.
+ * @param size The number of characters of the source.
+ */
+void indexLines(LineIndex *lines, const char *text, size_t size);
+
+/**
+ * @brief Forgets the part of an index after an offset.
+ *
+ * Used when the source changes from the offset on: the lines that begin up
+ * to the offset are kept, and the rest is scanned again on demand.
+ *
+ * @param lines The index to shorten.
+ * @param offset The first character that changed.
+ */
+void truncateLines(LineIndex *lines, size_t offset);
+
+/**
+ * @brief Finds the row and column of an offset.
+ *
+ * The column is the number of characters from the start of its row up to
+ * the offset, so the position right after a character is its column. The
+ * text is read as UTF-8: a multi-byte character counts as one column.
+ *
+ * @param lines An index that covers the offset.
+ * @param text The first character of the source.
+ * @param offset The offset to find.
+ * @return The position of the offset.
+ */
+Position linePosition(const LineIndex *lines, const char *text, size_t offset);
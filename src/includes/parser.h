@@ -1,39 +1,122 @@
 #pragma once
 
 #include "./lexer.h"
+#include "./stream.h"
+
+#define PARSER_LOOKAHEAD 4
+
+struct ASTNode;
+
+/**
+ * @struct Parser
+ * @brief Tracks the position of the parser in its input.
+ *
+ * The input is either a token stream filled beforehand, which the parser
+ * moves through by index, or the lexer itself, from which tokens are pulled
+ * on demand into a small ring buffer. In both cases the parser inspects the
+ * tokens ahead of it with peek.
+ *
+ * @var Parser::tokens
+ * The token stream being parsed, or NULL when tokens are pulled from the lexer.
+ *
+ * @var Parser::position
+ * The index of the current token in the input.
+ *
+ * @var Parser::keepTree
+ * Zero to free the tree of each statement once parsed, so that only the
+ * syntax is checked and memory does not grow with the input.
+ *
+ * @var Parser::lexer
+ * The lexer that reads the input: it holds the tokens of the table in
+ * stream mode and is asked for tokens in pull mode.
+ *
+ * @var Parser::lookahead
+ * Ring buffer with the last tokens pulled from the lexer, indexed by
+ * Token::index modulo PARSER_LOOKAHEAD.
+ *
+ * @var Parser::pulled
+ * The number of tokens pulled from the lexer.
+ *
+ * @var Parser::finished
+ * Non-zero once the lexer reached the end of the input or an error.
+ *
+ * @var Parser::last
+ * The last token of the input, where running out of input is reported.
+ *
+ * @var Parser::statement
+ * The node of the innermost statement being parsed.
+ *
+ * @var Parser::tags
+ * The statement that consumed each token since Parser::tagFrom, to be set
+ * as the tag of the token, or NULL when tokens are not tagged.
+ *
+ * @var Parser::tagFrom
+ * The index of the first token recorded in Parser::tags.
+ *
+ * @var Parser::tagCapacity
+ * The number of entries allocated for Parser::tags.
+ */
+typedef struct Parser
+{
+    const TokenStream *tokens;
+    size_t position;
+    int keepTree;
+    LexerContext *lexer;
+    Token lookahead[PARSER_LOOKAHEAD];
+    size_t pulled;
+    int finished;
+    Token last;
+    struct ASTNode *statement;
+    struct ASTNode **tags;
+    size_t tagFrom;
+    size_t tagCapacity;
+} Parser;
 
 /**
  * @brief Represents a node in an Abstract Syntax Tree (AST).
  * 
  * This structure is used to represent nodes in an AST, which is a tree representation
- * of the abstract syntactic structure of source code.
+ * of the abstract syntactic structure of source code. The value refers to the
+ * interned lexeme of the token (or to a constant string) and is not owned by
+ * the node, so it stays valid when the source text is edited; keywords are
+ * spelled in lower case. The length of the value is stored alongside.
+ *
+ * The statements of a compound statement are chained through next from its
+ * left child. Statement nodes also point to the statement that encloses
+ * them, which lets an edit find the smallest part of the tree to rebuild.
  */
 typedef struct ASTNode
 {
     int type;
-    char *value;
+    const char *value;
+    size_t length;
+    Atom atom;
     struct ASTNode *left;
     struct ASTNode *right;
+    struct ASTNode *next;
+    struct ASTNode *parent;
 } ASTNode;
 
 /**
  * @brief Creates a new ASTNode with the given type and value.
  *
  * This function allocates memory for a new ASTNode, initializes its type and value,
- * and sets its left and right children to NULL. If memory allocation fails, the
+ * and sets its atom to ATOM_NONE and its links to other nodes to NULL. If memory allocation fails, the
  * function prints an error message and exits the program.
  *
  * @param type The type of the ASTNode.
  * @param value The value of the ASTNode.
+ * @param length The number of characters in the value.
  * @return A pointer to the newly created ASTNode.
  */
-ASTNode *createNode(int type, char *value);
+ASTNode *createNode(int type, const char *value, size_t length);
 
 /**
  * @brief Frees the memory allocated for an ASTNode and its children.
  *
  * This function recursively frees the memory allocated for an ASTNode,
- * including its value, left child, and right child.
+ * including its left child, its right child and the statements chained after
+ * it. The value is not owned by the node and is left untouched.
  *
  * @param node A pointer to the ASTNode to be freed. If the node is NULL,
  *             the function does nothing.
@@ -41,13 +124,13 @@ ASTNode *createNode(int type, char *value);
 void freeNode(ASTNode *node);
 
 /**
- * Parses a conditional statement (if-then-else) from the given token table.
+ * Parses a conditional statement (if-then-else) from the token stream.
  *
- * @param table The symbol table used for parsing.
- * @param currentEntry A pointer to the current entry in the token table.
+ * @param parser The parser, positioned at the first token to parse. It is
+ *               advanced past the tokens consumed.
  * @return A pointer to the root ASTNode of the parsed conditional statement.
  *
- * The function expects the following structure in the token table:
+ * The function expects the following structure in the token stream:
  * - An 'if' reserved word followed by a condition expression.
  * - A 'then' reserved word followed by a statement.
  * - Optionally, an 'else' reserved word followed by another statement.
@@ -63,68 +146,65 @@ void freeNode(ASTNode *node);
  *   intermediate node representing the 'else' branch, with its left child being the
  *   'then' statement and its right child being the 'else' statement.
  */
-ASTNode *parseConditional(Table *table, Entry **currentEntry);
+ASTNode *parseConditional(Parser *parser);
 
 /**
- * Parses a repetitive structure (while-do loop) from the given table and current entry.
+ * Parses a repetitive structure (while-do loop) at the current position of the parser.
  *
- * @param table The symbol table used for parsing.
- * @param currentEntry A pointer to the current entry being parsed.
+ * @param parser The parser, positioned at the first token to parse. It is
+ *               advanced past the tokens consumed.
  * @return A pointer to the root ASTNode of the parsed while-do loop.
  *
- * The function expects the current entry to be a 'while' reserved word, followed by an expression,
+ * The function expects the current token to be a 'while' reserved word, followed by an expression,
  * then a 'do' reserved word, and finally a statement. If any of these expectations are not met,
  * the function will print an error message to stderr and exit the program.
  *
  * The resulting ASTNode will have the 'while' token as its root, the parsed expression as its left child,
  * and the parsed statement as its right child.
  */
-ASTNode *parseRepetitive(Table *table, Entry **currentEntry);
+ASTNode *parseRepetitive(Parser *parser);
 
 /**
- * Parses a factor in the given table and updates the current entry.
+ * Parses a factor at the current position of the parser and advances it.
  *
  * A factor can be a number, an identifier, or an expression enclosed in parentheses.
  * This function validates the factor and creates an AST node for it.
  *
- * @param table The symbol table used for parsing.
- * @param currentEntry A pointer to the current entry in the table. This will be updated to the next entry after parsing the factor.
+ * @param parser The parser, positioned at the first token to parse. It is
+ *               advanced past the tokens consumed.
  * @return A pointer to the created AST node representing the factor.
  *
  * @note This function will terminate the program with an error message if an invalid factor is encountered or if expected tokens are missing.
  */
-ASTNode *parseFactor(Table *table, Entry **currentEntry);
+ASTNode *parseFactor(Parser *parser);
 
 /**
  * Parses a term in the input and constructs an abstract syntax tree (AST) node representing the term.
  * A term is defined as a factor possibly followed by a multiplication operator and another factor.
  *
- * @param table A pointer to the symbol table used for parsing.
- * @param currentEntry A double pointer to the current entry in the input token stream.
- *                     This pointer will be updated as tokens are consumed during parsing.
+ * @param parser The parser, positioned at the first token to parse. It is
+ *               advanced past the tokens consumed.
  * 
  * @return A pointer to the root AST node representing the parsed term.
  *         The returned node may represent a single factor or a multiplication operation with factors as operands.
  */
-ASTNode *parseTerm(Table *table, Entry **currentEntry);
+ASTNode *parseTerm(Parser *parser);
 
 /**
- * Parses a simple expression from the given table and current entry.
+ * Parses a simple expression at the current position of the parser.
  * A simple expression can be a term optionally preceded by a unary operator
  * (either '+' or '-') and followed by zero or more terms separated by binary
  * operators ('+' or '-') forming a left-associative expression.
  *
- * @param table The symbol table used for parsing.
- * @param currentEntry A pointer to the current entry in the token list.
- *                     This pointer will be updated to point to the next entry
- *                     after parsing the simple expression.
+ * @param parser The parser, positioned at the first token to parse. It is
+ *               advanced past the tokens consumed.
  * @return A pointer to the root of the abstract syntax tree (AST) representing
  *         the parsed simple expression.
  */
-ASTNode *parseSimpleExpression(Table *table, Entry **currentEntry);
+ASTNode *parseSimpleExpression(Parser *parser);
 
 /**
- * @brief Parses an expression from the given table and current entry.
+ * @brief Parses an expression at the current position of the parser.
  *
  * This function parses an expression, which may include relational operators
  * such as '=', '<>', '<', '<=', '>', and '>='. It first parses a simple expression,
@@ -132,20 +212,20 @@ ASTNode *parseSimpleExpression(Table *table, Entry **currentEntry);
  * relation node and parses the right-hand side expression. The resulting AST node
  * represents the entire expression.
  *
- * @param table The symbol table used for parsing.
- * @param currentEntry A pointer to the current entry in the token list.
+ * @param parser The parser, positioned at the first token to parse. It is
+ *               advanced past the tokens consumed.
  * @return A pointer to the root AST node representing the parsed expression.
  *
  * @note If an expected expression is missing after a relational operator, the function
  *       prints an error message and exits the program.
  */
-ASTNode *parseExpression(Table *table, Entry **currentEntry);
+ASTNode *parseExpression(Parser *parser);
 
 /**
- * Parses an assignment statement from the given token table and current entry.
+ * Parses an assignment statement at the current position of the parser.
  *
- * @param table The symbol table containing the tokens.
- * @param currentEntry A pointer to the current entry in the token table.
+ * @param parser The parser, positioned at the first token to parse. It is
+ *               advanced past the tokens consumed.
  * @return A pointer to the root of the AST subtree representing the assignment statement.
  *
  * The function expects the following sequence of tokens:
@@ -166,16 +246,16 @@ ASTNode *parseExpression(Table *table, Entry **currentEntry);
  * - ERR_EXPECTED_EXPRESSION_AFTER_ASSIGNMENT: Expected an expression after the assignment operator.
  * - ERR_EXPECTED_SEMICOLON: Expected a semicolon at the end of the assignment statement.
  */
-ASTNode *parseAssignment(Table *table, Entry **currentEntry);
+ASTNode *parseAssignment(Parser *parser);
 
 /**
- * @brief Parses a statement from the given table and current entry.
+ * @brief Parses a statement at the current position of the parser.
  *
  * This function determines the type of statement based on the token type
  * and delegates the parsing to the appropriate function.
  *
- * @param table Pointer to the symbol table.
- * @param currentEntry Pointer to the current entry in the table.
+ * @param parser The parser, positioned at the first token to parse. It is
+ *               advanced past the tokens consumed.
  * @return ASTNode* Pointer to the abstract syntax tree node representing the parsed statement.
  *
  * The function handles the following types of statements:
@@ -188,66 +268,66 @@ ASTNode *parseAssignment(Table *table, Entry **currentEntry);
  * If the token type does not match any of the expected types, the function
  * prints an error message and exits the program.
  */
-ASTNode *parseStatement(Table *table, Entry **currentEntry);
+ASTNode *parseStatement(Parser *parser);
 
 /**
- * Parses a compound statement from the given table and current entry.
+ * Parses a compound statement at the current position of the parser.
  *
  * A compound statement is expected to start with the RESERVED_WORD_BEGIN and end with the RESERVED_WORD_END.
  * This function will create an ASTNode representing the compound statement and link it to the list of statements
  * contained within the compound statement.
  *
- * @param table The symbol table used for parsing.
- * @param currentEntry A pointer to the current entry in the token list. This will be updated to point to the next entry after parsing.
+ * @param parser The parser, positioned at the first token to parse. It is
+ *               advanced past the tokens consumed.
  * @return A pointer to the ASTNode representing the compound statement.
  *
  * @note This function will terminate the program with an error message if the expected tokens are not found.
  */
-ASTNode *parseCompoundStatement(Table *table, Entry **currentEntry);
+ASTNode *parseCompoundStatement(Parser *parser);
 
 /**
- * Parses a list of identifiers from the given table starting at the current entry.
+ * Parses a list of identifiers starting at the current position of the parser.
  *
- * @param table The table containing the entries to parse.
- * @param currentEntry A pointer to the current entry in the table. This will be updated to the next entry after parsing.
+ * @param parser The parser, positioned at the first token to parse. It is
+ *               advanced past the tokens consumed.
  * @return A pointer to the root of the AST node representing the identifier list.
  *
  * The function creates an AST node for each identifier in the list and links them together.
  * If an error is encountered (e.g., missing comma or colon, or an identifier expected after a comma),
  * an error message is printed to stderr and the program exits with a failure status.
  */
-ASTNode *parseIdentifierList(Table *table, Entry **currentEntry);
+ASTNode *parseIdentifierList(Parser *parser);
 
 /**
- * @brief Parses a declaration from the given table and current entry.
+ * @brief Parses a declaration at the current position of the parser.
  *
  * This function creates an AST node for a declaration, parses the identifier list,
  * and ensures the correct syntax for a declaration, including the presence of a colon,
  * a type, and a semicolon.
  *
- * @param table Pointer to the symbol table.
- * @param currentEntry Pointer to the current entry in the symbol table.
+ * @param parser The parser, positioned at the first token to parse. It is
+ *               advanced past the tokens consumed.
  * @return Pointer to the root AST node of the parsed declaration.
  *
  * @note This function will exit the program with an error message if the syntax is incorrect.
  */
-ASTNode *parseDeclaration(Table *table, Entry **currentEntry);
+ASTNode *parseDeclaration(Parser *parser);
 
 /**
- * @brief Parses a variable declaration from the given table and entry.
+ * @brief Parses a variable declaration at the current position of the parser.
  *
  * This function creates an AST node for a variable declaration and processes
- * subsequent declarations if they are present. It expects the current entry
- * to point to a token representing the 'var' keyword.
+ * subsequent declarations if they are present. It expects the current token
+ * to be the 'var' keyword.
  *
- * @param table Pointer to the symbol table.
- * @param currentEntry Pointer to the current entry in the token list.
+ * @param parser The parser, positioned at the first token to parse. It is
+ *               advanced past the tokens consumed.
  * @return Pointer to the root AST node representing the variable declaration.
  *
  * The function will exit with an error message if an identifier is not found
  * after the 'var' keyword or if there is a syntax error in the declaration.
  */
-ASTNode *parseVarDeclaration(Table *table, Entry **currentEntry);
+ASTNode *parseVarDeclaration(Parser *parser);
 
 /**
  * @brief Parses a block of code and constructs an abstract syntax tree (AST) node representing the block.
@@ -255,11 +335,11 @@ ASTNode *parseVarDeclaration(Table *table, Entry **currentEntry);
  * This function parses a block of code, which typically consists of variable declarations followed by a compound statement.
  * It creates an AST node for the block and attaches the parsed variable declarations and compound statement as child nodes.
  *
- * @param table A pointer to the symbol table used for parsing.
- * @param currentEntry A double pointer to the current entry in the symbol table. This pointer is updated as the parsing progresses.
+ * @param parser The parser, positioned at the first token to parse. It is
+ *               advanced past the tokens consumed.
  * @return A pointer to the root AST node representing the parsed block.
  */
-ASTNode *parseBlock(Table *table, Entry **currentEntry);
+ASTNode *parseBlock(Parser *parser);
 
 /**
  * Parses the program structure from the given token entries.
@@ -274,21 +354,55 @@ ASTNode *parseBlock(Table *table, Entry **currentEntry);
  * If any of these expectations are not met, the function will print an error
  * message to stderr and exit the program with a failure status.
  *
- * @param table The symbol table used for parsing.
- * @param currentEntry A pointer to the current entry in the token list.
- *                     This pointer will be updated to point to the next entry
- *                     after parsing the program structure.
+ * @param parser The parser, positioned at the first token to parse. It is
+ *               advanced past the tokens consumed.
  * @return A pointer to the root ASTNode representing the parsed program.
  */
-ASTNode *parseProgram(Table *table, Entry **currentEntry);
+ASTNode *parseProgram(Parser *parser);
+
+/**
+ * @brief Parses the tokens from the table of a lexer and constructs an abstract syntax tree (AST).
+ *
+ * This function takes the table of tokens already read by the lexer and parses them to construct
+ * an AST. If the table is empty, it prints an error message and exits the program.
+ *
+ * @param lexer The lexer whose table contains the tokens to be parsed.
+ * @return A pointer to the root ASTNode of the constructed abstract syntax tree.
+ */
+ASTNode *parseTokens(LexerContext *lexer);
 
 /**
- * @brief Parses the tokens from the given table and constructs an abstract syntax tree (AST).
+ * @brief Parses the input of the lexer while it is being read.
  *
- * This function takes a table of tokens and parses them to construct an AST. If the table is empty,
- * it prints an error message and exits the program.
+ * Tokens are pulled from the lexer as the parser needs them and only a few
+ * of them are kept at any time, so parsing starts with the first token and
+ * does not wait for the whole file to be lexed. If the input is empty, it
+ * prints an error message and exits the program.
  *
- * @param table A pointer to the Table structure containing the tokens to be parsed.
+ * @param lexer The lexer to pull the tokens from.
+ * @param keepTree Zero to discard the tree of each statement after parsing
+ *                 it, which bounds memory by the nesting depth of the program.
  * @return A pointer to the root ASTNode of the constructed abstract syntax tree.
  */
-ASTNode *parseTokens(Table *table);
\ No newline at end of file
+ASTNode *parseSource(LexerContext *lexer, int keepTree);
+
+/**
+ * @brief Updates the tree of the tokens of a lexer after relexEdit.
+ *
+ * Every token consumed by this parser is tagged with the statement that
+ * consumed it. The statements of the innermost compound statement holding
+ * both neighbours of the new tokens are parsed again, from the statement
+ * before the new tokens to the one after them, and take the place of the old
+ * ones in the tree. When the new statements do not end where the old ones
+ * did, the edit changed the structure around them, and the statement that
+ * encloses the compound statement is parsed again instead, up to the whole
+ * program. Syntax errors are reported and end the program as in parseTokens.
+ *
+ * @param lexer The lexer whose table holds the edited tokens.
+ * @param root The tree of the tokens before the edit, or NULL to parse all
+ *             the tokens into a new tree.
+ * @param first The index of the first token put in by the edit.
+ * @param count The number of tokens put in by the edit.
+ * @return The root of the updated tree; the old root is freed if it changed.
+ */
+ASTNode *parseEdit(LexerContext *lexer, ASTNode *root, size_t first, size_t count);
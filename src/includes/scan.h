@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * @brief Selects the instruction set used by the scanning kernels.
+ *
+ * ScanLevel:
+ * - SCAN_AUTO: The best level supported by the running CPU.
+ * - SCAN_SCALAR: Portable byte-at-a-time loops.
+ * - SCAN_SSE2: 16 bytes per step (x86).
+ * - SCAN_AVX2: 32 bytes per step (x86 with AVX2).
+ */
+typedef enum ScanLevel
+{
+    SCAN_AUTO,
+    SCAN_SCALAR,
+    SCAN_SSE2,
+    SCAN_AVX2
+} ScanLevel;
+
+/**
+ * @struct ScanKernels
+ * @brief Set of functions that skip runs of bytes belonging to one class.
+ *
+ * Each kernel receives the current position and the end of the buffer, and
+ * returns a pointer to the first byte that does not belong to the run (or the
+ * end of the buffer). They never read at or past the end of the buffer.
+ *
+ * @var ScanKernels::name
+ * A printable name of the instruction set used by the kernels.
+ *
+ * @var ScanKernels::spaces
+ * Skips spaces, tabs and new lines.
+ *
+ * @var ScanKernels::identifier
+ * Skips letters, digits and underscores.
+ *
+ * @var ScanKernels::digits
+ * Skips decimal digits.
+ *
+ * @var ScanKernels::string
+ * Skips the body of a string, stopping at a quote or a new line.
+ *
+ * @var ScanKernels::lineStarts
+ * Unlike the other kernels, reads the whole range: for every new line, writes
+ * the offset of the character after it to starts, counting cursor as offset,
+ * and returns the number of offsets written. starts must have room for one
+ * offset per byte of the range.
+ *
+ * @var ScanKernels::ascii
+ * Skips bytes below 0x80.
+ *
+ * @var ScanKernels::utf8
+ * Skips valid UTF-8 text, stopping at the first byte of a malformed sequence:
+ * one cut short by the end of the range, overlong, a surrogate or past
+ * U+10FFFF. Runs of ASCII are skipped without being decoded.
+ */
+typedef struct ScanKernels
+{
+    const char *name;
+    const char *(*spaces)(const char *cursor, const char *limit);
+    const char *(*identifier)(const char *cursor, const char *limit);
+    const char *(*digits)(const char *cursor, const char *limit);
+    const char *(*string)(const char *cursor, const char *limit);
+    size_t (*lineStarts)(const char *cursor, const char *limit, size_t offset, size_t *starts);
+    const char *(*ascii)(const char *cursor, const char *limit);
+    const char *(*utf8)(const char *cursor, const char *limit);
+} ScanKernels;
+
+/**
+ * @brief Returns the kernels implemented with the given instruction set.
+ *
+ * @param level The requested instruction set. SCAN_AUTO picks the best one
+ *              supported by the running CPU.
+ * @return The kernels, or NULL if the level is not supported on this CPU.
+ */
+const ScanKernels *getScanKernels(ScanLevel level);
+
+/**
+ * @brief Selects the kernels used by the lexer for the rest of the process.
+ *
+ * @param level The requested instruction set.
+ * @return 1 if the level is supported and was selected, 0 otherwise.
+ */
+int selectScanKernels(ScanLevel level);
+
+/**
+ * @brief Returns the kernels currently selected for the lexer.
+ *
+ * The best level supported by the CPU is selected on first use if
+ * selectScanKernels was never called.
+ *
+ * @return The selected kernels; never NULL.
+ */
+const ScanKernels *activeScanKernels(void);
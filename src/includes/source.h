@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * @struct Source
+ * @brief Represents the whole contents of an input file held in memory.
+ *
+ * The contents are either mapped read-only into the address space or, when
+ * mapping is not possible, read into a heap buffer in a single pass. The data
+ * is not NUL-terminated; always use Source::size to find its end.
+ *
+ * @var Source::data
+ * Pointer to the first byte of the file contents.
+ *
+ * @var Source::size
+ * The number of bytes available at Source::data.
+ *
+ * @var Source::mapped
+ * Non-zero when Source::data points to a memory mapping rather than a heap buffer.
+ */
+typedef struct Source
+{
+    const char *data;
+    size_t size;
+    int mapped;
+} Source;
+
+/**
+ * @brief Loads the contents of a file into memory.
+ *
+ * The file is mapped read-only with mmap when the platform supports it. If the
+ * mapping fails (empty files, pipes or non-POSIX platforms), the contents are
+ * read into a heap buffer instead.
+ *
+ * @param path The path of the file to load.
+ * @return A pointer to the loaded Source, or NULL if the file could not be read.
+ */
+Source *openSource(const char *path);
+
+/**
+ * @brief Releases a Source created by openSource.
+ *
+ * Unmaps or frees the file contents and the Source structure itself.
+ *
+ * @param source The Source to release. If NULL, the function does nothing.
+ */
+void closeSource(Source *source);
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "./lexer.h"
+
+#define TOKEN_CHUNK_BITS 12
+#define TOKEN_CHUNK_SIZE (1 << TOKEN_CHUNK_BITS)
+
+/**
+ * @brief Index returned when no token matches.
+ */
+#define TOKEN_NONE ((size_t)-1)
+
+/**
+ * @struct TokenChunk
+ * @brief Holds TOKEN_CHUNK_SIZE consecutive tokens as parallel arrays.
+ *
+ * Each attribute of the tokens is stored in its own array, so a walk that
+ * reads only kinds and atoms touches only those bytes. Offsets are stored
+ * relative to the chunk base to fit in 32 bits.
+ *
+ * @var TokenChunk::base
+ * The offset in the source buffer that the offsets of the chunk are relative to.
+ *
+ * @var TokenChunk::far
+ * Full offsets of the lexemes too far from TokenChunk::base, or NULL if
+ * there are none.
+ *
+ * @var TokenChunk::tag
+ * A pointer attached to each token by its consumer, or NULL if none was set.
+ *
+ * @var TokenChunk::kind
+ * The TokenKind of each token.
+ *
+ * @var TokenChunk::offset
+ * The offset of each lexeme, relative to TokenChunk::base. UINT32_MAX means
+ * the offset does not fit and is stored in TokenChunk::far.
+ *
+ * @var TokenChunk::length
+ * The number of characters of each lexeme.
+ *
+ * @var TokenChunk::atom
+ * The atom of each lexeme.
+ */
+typedef struct TokenChunk
+{
+    uint64_t base;
+    uint64_t *far;
+    void **tag;
+    uint8_t kind[TOKEN_CHUNK_SIZE];
+    uint32_t offset[TOKEN_CHUNK_SIZE];
+    uint32_t length[TOKEN_CHUNK_SIZE];
+    Atom atom[TOKEN_CHUNK_SIZE];
+} TokenChunk;
+
+/**
+ * @struct TokenStream
+ * @brief Sequence of tokens stored in fixed-size chunks.
+ *
+ * The stream grows one chunk at a time, so appending never moves the tokens
+ * already stored and costs no allocation per token. Splicing tokens in the
+ * middle only rebuilds the chunks it touches, which may leave them partially
+ * filled; the chunk of a token is then found by a binary search on
+ * TokenStream::starts instead of a shift.
+ *
+ * @var TokenStream::chunks
+ * The chunks of the stream.
+ *
+ * @var TokenStream::starts
+ * The index of the first token of each chunk.
+ *
+ * @var TokenStream::chunkCount
+ * The number of chunks in use.
+ *
+ * @var TokenStream::chunkCapacity
+ * The number of chunk pointers allocated.
+ *
+ * @var TokenStream::count
+ * The number of tokens in the stream.
+ *
+ * @var TokenStream::dense
+ * Non-zero while every chunk but the last one is full, so the chunk of a
+ * token is its index shifted by TOKEN_CHUNK_BITS.
+ */
+typedef struct TokenStream
+{
+    TokenChunk **chunks;
+    size_t *starts;
+    size_t chunkCount;
+    size_t chunkCapacity;
+    size_t count;
+    int dense;
+} TokenStream;
+
+/**
+ * @brief Creates an empty token stream.
+ *
+ * @return A pointer to the new stream. Exits the program if memory runs out.
+ */
+TokenStream *createTokenStream(void);
+
+/**
+ * @brief Removes all tokens of a stream, keeping it ready for reuse.
+ *
+ * @param stream The stream to empty.
+ */
+void clearTokenStream(TokenStream *stream);
+
+/**
+ * @brief Releases a token stream and all of its chunks.
+ *
+ * @param stream The stream to release. If NULL, the function does nothing.
+ */
+void freeTokenStream(TokenStream *stream);
+
+/**
+ * @brief Appends a token at the end of a stream.
+ *
+ * @param stream The stream that receives the token.
+ * @param token The token to append. Its name and type are not stored, since
+ *              they derive from its kind.
+ * @return The index of the token in the stream.
+ */
+size_t appendToken(TokenStream *stream, const Token *token);
+
+/**
+ * @brief Makes room at the end of a stream for the tokens of several parts.
+ *
+ * The stream grows by the total number of tokens of the parts, in order, and
+ * its new chunks are prepared so that copyTokens can then fill the room of
+ * each part independently, from several threads at once. The stream and the
+ * parts must be dense.
+ *
+ * @param stream The stream that grows.
+ * @param parts The streams whose tokens will be copied, in order.
+ * @param partCount The number of parts.
+ * @return The index in the stream of the first token of the first part.
+ */
+size_t reserveTokens(TokenStream *stream, TokenStream *const *parts, size_t partCount);
+
+/**
+ * @brief Copies the tokens of a part into room made by reserveTokens.
+ *
+ * @param stream The stream that receives the tokens.
+ * @param at The index in the stream of the first token of the part.
+ * @param part The stream whose tokens are copied.
+ * @param remap Atom of the stream for each atom of the part, or NULL to keep
+ *              the atoms unchanged.
+ */
+void copyTokens(TokenStream *stream, size_t at, const TokenStream *part, const Atom *remap);
+
+/**
+ * @brief Replaces a range of tokens of a stream with the tokens of another.
+ *
+ * Only the chunks holding the range are rebuilt. The tokens after the range
+ * keep their tags and move by the given number of bytes, which costs one
+ * update per chunk rather than one per token.
+ *
+ * @param stream The stream whose tokens are replaced.
+ * @param from The index of the first token replaced.
+ * @param removed The number of tokens replaced.
+ * @param replacement The tokens inserted in their place, with their final
+ *                    offsets; they get no tag.
+ * @param offsetDelta The number of bytes the tokens after the range move by.
+ */
+void spliceTokens(TokenStream *stream, size_t from, size_t removed, const TokenStream *replacement, ptrdiff_t offsetDelta);
+
+/**
+ * @brief Finds the first token whose lexeme starts at or after an offset.
+ *
+ * @param stream The stream to search.
+ * @param offset The offset in the source buffer.
+ * @return The index of the token, or TokenStream::count if there is none.
+ */
+size_t findToken(const TokenStream *stream, size_t offset);
+
+/**
+ * @brief Attaches a pointer to a token.
+ *
+ * @param stream The stream holding the token.
+ * @param index The index of the token.
+ * @param tag The pointer to attach.
+ */
+void setTokenTag(TokenStream *stream, size_t index, void *tag);
+
+/**
+ * @brief Returns the pointer attached to a token.
+ *
+ * @param stream The stream holding the token.
+ * @param index The index of the token.
+ * @return The pointer set by setTokenTag, or NULL if none was set.
+ */
+void *tokenTag(const TokenStream *stream, size_t index);
+
+/**
+ * @brief Rebuilds the view of a stored token.
+ *
+ * @param stream The stream holding the token.
+ * @param index The index of the token, which must be lower than TokenStream::count.
+ * @return The token.
+ */
+Token streamToken(const TokenStream *stream, size_t index);
@@ -1,524 +1,1171 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
 #include "../includes/lexer.h"
+#include "../includes/atoms.h"
+#include "../includes/stream.h"
 #include "../includes/tokens.h"
 #include "../includes/errors.h"
+#include "../includes/scan.h"
 
-static int column = 0, row = 1;
-static char ch;
+static Token scanToken(LexerContext *lexer);
+static size_t utf8Length(const char *cursor, const char *limit);
+static const char *commentEnd(const char *cursor, const char *limit);
 
-static void removeWord(char **word, int *size);
+// character classes of the automaton (see src/FLAP); every input byte is
+// mapped to one of them through a single lookup in charClasses:
+enum
+{
+	C_OTHER,
+	C_SPACE,
+	C_NEW_LINE,
+	C_ALPHA,
+	C_DIGIT,
+	C_DOT,
+	C_SYMBOL,
+	C_COLON,
+	C_QUOTE,
+	C_ARITH,
+	C_SLASH,
+	C_STAR,
+	C_OPEN_PAREN,
+	C_CLOSE_PAREN,
+	C_OPEN_BRACE,
+	C_CLOSE_BRACE,
+	C_RELATIONAL,
+	C_EQU,
+	C_WIDE,
+	C_EOF,
+	CLASS_COUNT
+};
+
+// states of the automaton. S_START..S_STRING are the original q0..q6 (q4 is
+// split in two so that '<=' and '>=' need no look-behind); F_* are final
+// states reached after consuming the last character of a lexeme:
+enum
+{
+	S_START,   // q0
+	S_IDENT,   // q1
+	S_INT,     // q2
+	S_REAL,    // q3
+	S_REL,     // q4
+	S_REL_EQU, // q4, after '='
+	S_COLON,   // q5
+	S_STRING,  // q6
+	S_SLASH,
+	S_COMMENT,
+	S_PAREN,
+	S_BRACE_COMMENT,
+	S_STAR_COMMENT,
+	S_STAR_END,
+	F_SYMBOL,
+	F_ARITH,
+	F_ASSIGN,
+	F_STRING,
+	STATE_COUNT
+};
+
+// actions, stored in the high byte of a transition next to the target state:
+enum
+{
+	A_SHIFT = 0x000,   // append the character and move to the target state
+	A_SKIP = 0x100,	   // consume the character without appending it
+	A_LINE = 0x200,	   // consume a new line
+	A_ACCEPT = 0x300,  // append the character and emit the final target state
+	A_RETRACT = 0x400, // emit the current state without consuming the character
+	A_ERR_CHAR = 0x500,
+	A_ERR_IDENT = 0x600,
+	A_ERR_STRING = 0x700,
+	A_END = 0x800,
+	A_ERR_UTF8 = 0x900,
+	A_ERR_COMMENT = 0xA00
+};
+
+static const unsigned char charClasses[256] = {
+	[SPACE] = C_SPACE,
+	[TAB] = C_SPACE,
+	[NEW_LINE] = C_NEW_LINE,
+	['a' ... 'z'] = C_ALPHA,
+	['A' ... 'Z'] = C_ALPHA,
+	[SMB_UNDER] = C_ALPHA,
+	['0' ... '9'] = C_DIGIT,
+	[SMB_DOT] = C_DOT,
+	[SMB_OBC] = C_OPEN_BRACE,
+	[SMB_CBC] = C_CLOSE_BRACE,
+	[SMB_SEM] = C_SYMBOL,
+	[SMB_OPA] = C_OPEN_PAREN,
+	[SMB_CPA] = C_CLOSE_PAREN,
+	[SMB_COM] = C_SYMBOL,
+	[SMB_COLON] = C_COLON,
+	[SMB_SQT] = C_QUOTE,
+	[SMB_DQT] = C_QUOTE,
+	[OP_SUM] = C_ARITH,
+	[OP_SUB] = C_ARITH,
+	[OP_MUL] = C_STAR,
+	[OP_DIV] = C_SLASH,
+	[OP_LT] = C_RELATIONAL,
+	[OP_GT] = C_RELATIONAL,
+	[OP_EQU] = C_EQU,
+	[0x80 ... 0xFF] = C_WIDE,
+};
+
+static const unsigned short transitions[S_STAR_END + 1][CLASS_COUNT] = {
+	// q0: initial state, skipping white spaces and choosing the kind of lexeme:
+	[S_START] = {
+		[C_OTHER] = A_ERR_CHAR,
+		[C_SPACE] = A_SKIP | S_START,
+		[C_NEW_LINE] = A_LINE | S_START,
+		[C_ALPHA] = A_SHIFT | S_IDENT,
+		[C_DIGIT] = A_SHIFT | S_INT,
+		[C_DOT] = A_ACCEPT | F_SYMBOL,
+		[C_SYMBOL] = A_ACCEPT | F_SYMBOL,
+		[C_COLON] = A_SHIFT | S_COLON,
+		[C_QUOTE] = A_SHIFT | S_STRING,
+		[C_ARITH] = A_ACCEPT | F_ARITH,
+		[C_SLASH] = A_SHIFT | S_SLASH,
+		[C_STAR] = A_ACCEPT | F_ARITH,
+		[C_OPEN_PAREN] = A_SHIFT | S_PAREN,
+		[C_CLOSE_PAREN] = A_ACCEPT | F_SYMBOL,
+		[C_OPEN_BRACE] = A_SKIP | S_BRACE_COMMENT,
+		[C_CLOSE_BRACE] = A_ACCEPT | F_SYMBOL,
+		[C_RELATIONAL] = A_SHIFT | S_REL,
+		[C_EQU] = A_ERR_CHAR,
+		[C_WIDE] = A_ERR_CHAR,
+		[C_EOF] = A_END,
+	},
+	// q1: identifiers and reserved words:
+	[S_IDENT] = {
+		[0 ... CLASS_COUNT - 1] = A_RETRACT,
+		[C_ALPHA] = A_SHIFT | S_IDENT,
+		[C_DIGIT] = A_SHIFT | S_IDENT,
+	},
+	// q2: integers and possible real numbers:
+	[S_INT] = {
+		[0 ... CLASS_COUNT - 1] = A_RETRACT,
+		[C_DIGIT] = A_SHIFT | S_INT,
+		[C_DOT] = A_SHIFT | S_REAL,
+		[C_ALPHA] = A_ERR_IDENT,
+	},
+	// q3: real numbers:
+	[S_REAL] = {
+		[0 ... CLASS_COUNT - 1] = A_RETRACT,
+		[C_DIGIT] = A_SHIFT | S_REAL,
+	},
+	// q4: relational operators:
+	[S_REL] = {
+		[0 ... CLASS_COUNT - 1] = A_RETRACT,
+		[C_EQU] = A_SHIFT | S_REL_EQU,
+	},
+	[S_REL_EQU] = {
+		[0 ... CLASS_COUNT - 1] = A_RETRACT,
+	},
+	// q5: assignment operator or colon symbol:
+	[S_COLON] = {
+		[0 ... CLASS_COUNT - 1] = A_RETRACT,
+		[C_EQU] = A_ACCEPT | F_ASSIGN,
+	},
+	// q6: strings. Bytes past ASCII are only read here and in comments, by
+	// the UTF-8 kernel; one left for the table begins a malformed sequence:
+	[S_STRING] = {
+		[0 ... CLASS_COUNT - 1] = A_SHIFT | S_STRING,
+		[C_QUOTE] = A_ACCEPT | F_STRING,
+		[C_NEW_LINE] = A_ERR_STRING,
+		[C_WIDE] = A_ERR_UTF8,
+		[C_EOF] = A_ERR_STRING,
+	},
+	// division operator or line comment:
+	[S_SLASH] = {
+		[0 ... CLASS_COUNT - 1] = A_RETRACT,
+		[C_SLASH] = A_SKIP | S_COMMENT,
+	},
+	[S_COMMENT] = {
+		[0 ... CLASS_COUNT - 1] = A_SKIP | S_COMMENT,
+		[C_NEW_LINE] = A_LINE | S_START,
+		[C_WIDE] = A_ERR_UTF8,
+		[C_EOF] = A_END,
+	},
+	// open parenthesis or '(*' comment:
+	[S_PAREN] = {
+		[0 ... CLASS_COUNT - 1] = A_RETRACT,
+		[C_STAR] = A_SKIP | S_STAR_COMMENT,
+	},
+	// block comments may span lines and must be closed before the input ends:
+	[S_BRACE_COMMENT] = {
+		[0 ... CLASS_COUNT - 1] = A_SKIP | S_BRACE_COMMENT,
+		[C_NEW_LINE] = A_LINE | S_BRACE_COMMENT,
+		[C_CLOSE_BRACE] = A_SKIP | S_START,
+		[C_WIDE] = A_ERR_UTF8,
+		[C_EOF] = A_ERR_COMMENT,
+	},
+	[S_STAR_COMMENT] = {
+		[0 ... CLASS_COUNT - 1] = A_SKIP | S_STAR_COMMENT,
+		[C_NEW_LINE] = A_LINE | S_STAR_COMMENT,
+		[C_STAR] = A_SKIP | S_STAR_END,
+		[C_WIDE] = A_ERR_UTF8,
+		[C_EOF] = A_ERR_COMMENT,
+	},
+	// after a '*' in a '(*' comment:
+	[S_STAR_END] = {
+		[0 ... CLASS_COUNT - 1] = A_SKIP | S_STAR_COMMENT,
+		[C_NEW_LINE] = A_LINE | S_STAR_COMMENT,
+		[C_STAR] = A_SKIP | S_STAR_END,
+		[C_CLOSE_PAREN] = A_SKIP | S_START,
+		[C_WIDE] = A_ERR_UTF8,
+		[C_EOF] = A_ERR_COMMENT,
+	},
+};
+
+// token emitted for every state that can end a lexeme:
+static const TokenKind accepting[STATE_COUNT] = {
+	[S_IDENT] = KIND_IDENTIFIER,
+	[S_INT] = KIND_INTEGER,
+	[S_REAL] = KIND_REAL,
+	[S_REL] = KIND_RELATIONAL,
+	[S_REL_EQU] = KIND_RELATIONAL,
+	[S_COLON] = KIND_SYMBOL,
+	[S_SLASH] = KIND_ARITHMETIC,
+	[S_PAREN] = KIND_SYMBOL,
+	[F_SYMBOL] = KIND_SYMBOL,
+	[F_ARITH] = KIND_ARITHMETIC,
+	[F_ASSIGN] = KIND_ASSIGNMENT,
+	[F_STRING] = KIND_STRING,
+};
+
+// type and printed name of every kind of token:
+static const struct
+{
+	TokenType type;
+	char *name;
+} kinds[TOKEN_KIND_COUNT] = {
+	[KIND_RESERVED_WORD] = {RESERVED_WORD, "Reserved-word"},
+	[KIND_RESERVED_TYPE] = {RESERVED_TYPE, "Reserved-type"},
+	[KIND_RESERVED_OPERATOR] = {RESERVED_OPERATOR, "Reserved-operator"},
+	[KIND_IDENTIFIER] = {IDENTIFIER, "Identifier"},
+	[KIND_INTEGER] = {NUMBER, "Integer number"},
+	[KIND_REAL] = {NUMBER, "Real number"},
+	[KIND_RELATIONAL] = {OPERATOR, "Relational Operator"},
+	[KIND_ARITHMETIC] = {OPERATOR, "Binary Arithmetic Operator"},
+	[KIND_ASSIGNMENT] = {OPERATOR, "Assignment Operator"},
+	[KIND_SYMBOL] = {SYMBOL, "Symbol"},
+	[KIND_STRING] = {STRING, "String"},
+	[KIND_END_OF_FILE] = {END_OF_FILE, "EOF"},
+	[KIND_ERROR] = {ERROR, "Error"},
+};
+
+LexerContext *createLexer(const Source *source)
+{
+	LexerContext *lexer = (LexerContext *)malloc(sizeof(LexerContext));
+
+	if (lexer == NULL)
+	{
+		fprintf(stderr, ERR_MEMORY_ALLOCATION_FAILED);
+		exit(EXIT_FAILURE);
+	}
+
+	// the kernels are picked once, before any lexer may run on a thread:
+	activeScanKernels();
+
+	lexer->base = source->data;
+	lexer->cursor = source->data;
+	lexer->limit = source->data + source->size;
+	lexer->stop = lexer->limit;
+	lexer->lines = NULL;
+	lexer->report = 1;
+	lexer->table = initTable();
+
+	return lexer;
+}
+
+void freeLexer(LexerContext *lexer)
+{
+	if (lexer == NULL)
+		return;
+
+	freeTable(lexer->table);
+	freeLineIndex(lexer->lines);
+	free(lexer);
+}
+
+const char *tokenLexeme(const LexerContext *lexer, const Token *token)
+{
+	return lexer->base + token->offset;
+}
+
+char *tokenWord(const LexerContext *lexer, const Token *token)
+{
+	char *word = (char *)malloc(token->length + 1);
 
-Token *lexerAnalysis(Table *table)
+	if (word == NULL)
+		return NULL;
+
+	memcpy(word, tokenLexeme(lexer, token), token->length);
+	word[token->length] = END_OF_STRING;
+
+	return word;
+}
+
+Position sourcePosition(LexerContext *lexer, size_t offset)
+{
+	if (lexer->lines == NULL)
+		lexer->lines = createLineIndex();
+
+	indexLines(lexer->lines, lexer->base, (size_t)(lexer->limit - lexer->base));
+
+	return linePosition(lexer->lines, lexer->base, offset);
+}
+
+Position tokenPosition(LexerContext *lexer, const Token *token)
+{
+	// the position right after the last character is the column of that
+	// character:
+	return sourcePosition(lexer, token->offset + token->length);
+}
+
+Token lexerAnalysis(LexerContext *lexer)
+{
+	Token token = scanToken(lexer);
+
+	if (token.type != END_OF_FILE && token.type != ERROR)
+		insertTable(lexer->table, &token);
+
+	return token;
+}
+
+// chunks smaller than this are not worth a thread of their own:
+#define PARALLEL_MIN_CHUNK (1 << 20)
+#define PARALLEL_MAX_THREADS 64
+
+// one chunk of the input in the parallel mode, with the lexer that reads it
+// into a table of its own and where its tokens go once stitched:
+typedef struct LexChunk
+{
+	LexerContext lexer;
+	const char *start;
+	Token last;
+	Table *target;
+	size_t at;
+	Atom *remap;
+} LexChunk;
+
+static void *lexChunk(void *argument)
 {
-	char *word = (char *)malloc(sizeof(char));
-	int state = 0, size = 0;
+	LexChunk *chunk = (LexChunk *)argument;
+	Token token;
 
-	while ((ch = fgetc(input)) != EOF)
+	while ((token = lexerAnalysis(&chunk->lexer)).type != END_OF_FILE && token.type != ERROR);
+
+	chunk->last = token;
+
+	return NULL;
+}
+
+// a chunk that begins inside a comment of the one before is lexed again from
+// where that comment ends, until a token matches one it already has:
+static void resyncChunk(LexChunk *chunk, const char *resume)
+{
+	Table *table = chunk->lexer.table;
+	TokenStream *tokens = table->tokens;
+	TokenStream *fresh = createTokenStream();
+	size_t to = 0;
+	Token token;
+
+	// the comment may cover the whole chunk:
+	if (chunk->lexer.stop < resume)
+		chunk->lexer.stop = resume;
+
+	chunk->lexer.cursor = resume;
+	chunk->start = resume;
+
+	for (;;)
 	{
-		column++;
+		token = scanToken(&chunk->lexer);
 
-		switch (state)
+		if (token.type == END_OF_FILE || token.type == ERROR)
+		{
+			to = tokens->count;
+			chunk->last = token;
+			break;
+		}
+
+		Token old;
+
+		while (to < tokens->count && (old = streamToken(tokens, to)).offset < token.offset)
+			to++;
+
+		if (to < tokens->count && old.offset == token.offset && old.length == token.length && old.kind == token.kind)
+			break;
+
+		appendToken(fresh, &token);
+	}
+
+	spliceTable(table, 0, to, fresh, 0);
+	freeTokenStream(fresh);
+
+	// first occurrences that were replaced are found again before the
+	// symbols are merged:
+	for (size_t index = 0; index < tokens->count; index++)
+	{
+		Atom atom = streamToken(tokens, index).atom;
+
+		if (atom == ATOM_NONE)
+			continue;
+
+		Symbol *symbol = findSymbol(table->symbols, table->symbolCapacity, atom);
+
+		if (symbol->first == TOKEN_NONE)
+			symbol->first = index;
+	}
+}
+
+static void *stitchChunk(void *argument)
+{
+	LexChunk *chunk = (LexChunk *)argument;
+
+	copyTokens(chunk->target->tokens, chunk->at, chunk->lexer.table->tokens, chunk->remap);
+
+	return NULL;
+}
+
+Token lexerAnalysisParallel(LexerContext *lexer, int threads)
+{
+	Table *table = lexer->table;
+	size_t remaining = (size_t)(lexer->limit - lexer->cursor);
+	Token token;
+
+	if (threads > PARALLEL_MAX_THREADS)
+		threads = PARALLEL_MAX_THREADS;
+
+	if ((size_t)threads > remaining / PARALLEL_MIN_CHUNK)
+		threads = (int)(remaining / PARALLEL_MIN_CHUNK);
+
+	if (threads <= 1)
+	{
+		while ((token = lexerAnalysis(lexer)).type != END_OF_FILE && token.type != ERROR);
+
+		return token;
+	}
+
+	LexChunk chunks[PARALLEL_MAX_THREADS];
+	pthread_t workers[PARALLEL_MAX_THREADS];
+	int running[PARALLEL_MAX_THREADS];
+	int count = 0;
+
+	// every chunk but the first begins right after a line break, where the
+	// sequential lexer is back in q0:
+	for (const char *start = lexer->cursor; start < lexer->limit && count < threads; count++)
+	{
+		const char *end = count == threads - 1 ? lexer->limit : lexer->cursor + remaining / threads * (count + 1);
+
+		if (end < start)
+			end = start;
+
+		if (end < lexer->limit)
 		{
-		// q0:
-		// initial state, identifying white spaces, numeric values,
-		// alphanumeric values, symbolic values, and operators:
-		case 0:
+			const char *newLine = (const char *)memchr(end, NEW_LINE, lexer->limit - end);
+			end = newLine ? newLine + 1 : lexer->limit;
+		}
+
+		chunks[count].lexer = *lexer;
+		chunks[count].lexer.cursor = start;
+		chunks[count].lexer.stop = end;
+		chunks[count].lexer.lines = NULL;
+		chunks[count].lexer.report = 0;
+		chunks[count].start = start;
+		chunks[count].lexer.table = initTable();
+
+		start = end;
+	}
+
+	// a chunk whose thread cannot be started is lexed on this one:
+	for (int index = 0; index < count; index++)
+	{
+		running[index] = pthread_create(&workers[index], NULL, lexChunk, &chunks[index]) == 0;
+
+		if (!running[index])
+			lexChunk(&chunks[index]);
+	}
+
+	for (int index = 0; index < count; index++)
+	{
+		if (running[index])
+			pthread_join(workers[index], NULL);
+	}
+
+	// a comment may run past the end of its chunk, where the chunk after it
+	// did not know it began:
+	for (int index = 1; index < count && chunks[index - 1].last.type != ERROR; index++)
+	{
+		const char *resume = lexer->base + chunks[index - 1].last.offset;
+
+		if (resume > chunks[index].start)
+			resyncChunk(&chunks[index], resume);
+	}
+
+	// the chunks before the first one that ends in an error are kept:
+	int stitched = 0;
+
+	while (stitched < count && chunks[stitched].last.type != ERROR)
+		stitched++;
+
+	// atoms are interned again part by part, which gives them the numbers
+	// the sequential lexer would have given, and symbols are merged the same
+	// way; the tokens themselves are then copied on all threads:
+	TokenStream *parts[PARALLEL_MAX_THREADS] = {NULL};
+	size_t at = table->tokens->count;
+
+	for (int index = 0; index < stitched; index++)
+	{
+		AtomTable *atoms = chunks[index].lexer.table->atoms;
+		Table *part = chunks[index].lexer.table;
+
+		chunks[index].remap = (Atom *)malloc(atoms->count * sizeof(Atom));
+
+		if (chunks[index].remap == NULL)
 		{
-			// identyfing spaces, tabs, new lines and comments:
-			if (ch == SPACE || ch == TAB || ch == NEW_LINE)
-			{
-				if (ch == NEW_LINE)
-				{
-					row++;
-					column = 0;
-					break;
-				}
+			fprintf(stderr, ERR_MEMORY_ALLOCATION_FAILED);
+			exit(EXIT_FAILURE);
+		}
 
-				break;
-			}
+		for (Atom atom = 0; atom < atoms->count; atom++)
+			chunks[index].remap[atom] = atom < ATOM_PREDEFINED_COUNT ? atom : internAtom(table->atoms, atomName(atoms, atom), atoms->infos[atom].length);
 
-			// identifying numeric values:
-			if (ch >= '0' && ch <= '9')
-			{
-				addWord(&word, &size, ch);
-				state = 2;
+		for (size_t slot = 0; slot < part->symbolCapacity; slot++)
+		{
+			if (part->symbols[slot].atom != ATOM_NONE && part->symbols[slot].count > 0)
+				addSymbol(table, chunks[index].remap[part->symbols[slot].atom], at + part->symbols[slot].first, part->symbols[slot].count);
+		}
 
-				break;
-			}
+		parts[index] = part->tokens;
+		chunks[index].target = table;
+		chunks[index].at = at;
+		at += part->tokens->count;
+	}
 
-			// identyfing alfanumeric values:
-			if (ch >= 'a' && ch <= 'z' || ch >= 'A' && ch <= 'Z' || ch >= '0' && ch <= '9' || ch == SMB_UNDER)
-			{
-				addWord(&word, &size, ch);
-				state = 1;
+	reserveTokens(table->tokens, parts, (size_t)stitched);
 
-				break;
-			}
+	for (int index = 0; index < stitched; index++)
+	{
+		running[index] = pthread_create(&workers[index], NULL, stitchChunk, &chunks[index]) == 0;
 
-			// identifying symbols:
-			if (ch == SMB_OBC || ch == SMB_CBC || ch == SMB_SEM || ch == SMB_OPA || ch == SMB_CPA || ch == SMB_DOT || ch == SMB_COM || ch == SMB_COLON || ch == SMB_SQT || ch == SMB_DQT)
-			{
-				addWord(&word, &size, ch);
+		if (!running[index])
+			stitchChunk(&chunks[index]);
+	}
 
-				if (ch == SMB_COLON)
-				{
-					state = 5;
-					break;
-				}
-				else if (ch == SMB_SQT || ch == SMB_DQT)
-				{
-					state = 6;
-					break;
-				}
-				else
-				{
-					Token *token = createToken(SYMBOL, "Symbol", word, row, column);
-					insertTable(table, word, token);
-					return token;
-				}
-			}
+	for (int index = 0; index < stitched; index++)
+	{
+		if (running[index])
+			pthread_join(workers[index], NULL);
 
-			// identyfing operators:
-			if (ch == OP_SUM || ch == OP_SUB || ch == OP_DIV || ch == OP_MUL || ch == OP_LT || ch == OP_GT)
-			{
-				addWord(&word, &size, ch);
+		free(chunks[index].remap);
+	}
 
-				if (ch == OP_SUM || ch == OP_SUB || ch == OP_DIV || ch == OP_MUL)
-				{
-					if(ch == OP_DIV && (ch = fgetc(input)) == OP_DIV)
-					{
-						removeWord(&word, &size);
-						
-						while ((ch = fgetc(input)) != NEW_LINE)
-						{
-							column++;
-						}
-						row++;
-						column = 0;
-						break;
-					}
-
-					Token *token = createToken(OPERATOR, "Binary Arithmetic Operator", word, row, column);
-					insertTable(table, word, token);
-					return token;
-				}
-				else
-				{
-					state = 4;
-				}
+	if (stitched < count)
+	{
+		// the chunk holding the error is lexed again where it begins, so the
+		// error is reported and its tokens are kept as the sequential lexer
+		// would do:
+		lexer->cursor = chunks[stitched].start;
+
+		while ((token = lexerAnalysis(lexer)).type != END_OF_FILE && token.type != ERROR);
+	}
+	else
+	{
+		token = chunks[count - 1].last;
+		lexer->cursor = lexer->limit;
+	}
+
+	for (int index = 0; index < count; index++)
+		freeTable(chunks[index].lexer.table);
+
+	return token;
+}
+
+Token relexEdit(LexerContext *lexer, size_t offset, size_t removed, size_t inserted, size_t *first, size_t *count)
+{
+	Table *table = lexer->table;
+	TokenStream *tokens = table->tokens;
+	ptrdiff_t delta = (ptrdiff_t)inserted - (ptrdiff_t)removed;
+	size_t from = findToken(tokens, offset), to = findToken(tokens, offset + removed);
+	LexerContext scanner = *lexer;
+	Token token;
+
+	// the automaton is back in q0 after every token, so lexing restarts
+	// after the last token that ends before the edit; one ending right at
+	// it has looked at a character that changed:
+	while (from > 0)
+	{
+		token = streamToken(tokens, from - 1);
+
+		if (token.offset + token.length < offset)
+			break;
+
+		from--;
+	}
+
+	scanner.cursor = from > 0 ? lexer->base + token.offset + token.length : lexer->base;
+
+	// lines that begin after the edit are found again when a position is
+	// next asked for:
+	if (lexer->lines != NULL)
+		truncateLines(lexer->lines, offset);
+
+	TokenStream *fresh = createTokenStream();
+
+	// new tokens replace the old ones until one past the edit matches an
+	// old token at the same place; everything after it is lexed the same:
+	for (;;)
+	{
+		token = scanToken(&scanner);
 
+		if (token.type == END_OF_FILE || token.type == ERROR)
+		{
+			to = tokens->count;
+			break;
+		}
+
+		if (token.offset >= offset + inserted)
+		{
+			Token old;
+
+			while (to < tokens->count && (old = streamToken(tokens, to)).offset + delta < token.offset)
+				to++;
+
+			if (to < tokens->count && old.offset + delta == token.offset && old.length == token.length && old.kind == token.kind)
 				break;
-			}
+		}
+
+		appendToken(fresh, &token);
+	}
+
+	spliceTable(table, from, to - from, fresh, delta);
+
+	*first = from;
+	*count = fresh->count;
+
+	freeTokenStream(fresh);
+	lexer->cursor = lexer->limit;
+	// an error report may have built the index on the copy:
+	lexer->lines = scanner.lines;
+
+	return token;
+}
+
+Token nextToken(LexerContext *lexer)
+{
+	return scanToken(lexer);
+}
+
+// the cursor is kept in a local while scanning and stored back once the
+// token is complete; rows and columns are only looked up for errors:
+static Token scanToken(LexerContext *lexer)
+{
+	const ScanKernels *kernels = activeScanKernels();
+	AtomTable *atoms = lexer->table->atoms;
+	const char *base = lexer->base, *cursor = lexer->cursor, *limit = lexer->limit, *stop = lexer->stop;
+	const char *start = cursor;
+	int state = S_START;
+	Token token;
+
+	for (int scanning = 1; scanning;)
+	{
+		// runs of bytes that keep the automaton in its current state are
+		// skipped by the vectorised kernels before the next transition:
+		switch (state)
+		{
+		case S_START:
+		{
+			// every lexeme begins with the transition out of q0, and none
+			// begins past the stop:
+			cursor = start = kernels->spaces(cursor, stop);
+			break;
+		}
 
-			addWord(&word, &size, ch);
-			fprintf(stderr, ERR_UNKOWN_CHARACTER, ch, row, column);
-			return NULL;
+		case S_IDENT:
+		case S_INT:
+		case S_REAL:
+		{
+			cursor = state == S_IDENT ? kernels->identifier(cursor, limit) : kernels->digits(cursor, limit);
+			break;
 		}
 
-		// q1:
-		// handling alphanumeric values and identifying reserved words
-		// and identifiers:
-		case 1:
+		case S_STRING:
+		case S_COMMENT:
+		case S_BRACE_COMMENT:
+		case S_STAR_COMMENT:
 		{
-			if (ch >= 'a' && ch <= 'z' || ch >= 'A' && ch <= 'Z' || ch >= '0' && ch <= '9' || ch == SMB_UNDER)
-			{
-				addWord(&word, &size, ch);
-			}
+			// comments are skipped at once up to their terminator:
+			const char *end;
+
+			if (state == S_STRING)
+				end = kernels->string(cursor, limit);
+			else if (state == S_STAR_COMMENT)
+				end = commentEnd(cursor, limit);
 			else
-			{
-				ungetc(ch, input);
-				column--;
+				end = (const char *)memchr(cursor, state == S_COMMENT ? NEW_LINE : SMB_CBC, limit - cursor);
 
-				if (!isValidIdentifier(word))
-				{
-					fprintf(stderr, ERR_INVALID_IDENTIFIER, word, row, column);
-					return NULL;
-				}
+			// the run ends early at a malformed UTF-8 sequence:
+			cursor = kernels->utf8(cursor, end ? end : limit);
+			break;
+		}
+		}
 
-				if (isReservedWord(word))
-				{
-					Token *token = createToken(RESERVED_WORD, "Reserved-word", word, row, column);
-					insertTable(table, word, token);
-					return token;
-				}
-				else if (isReservedType(word))
-				{
-					Token *token = createToken(RESERVED_TYPE, "Reserved-type", word, row, column);
-					insertTable(table, word, token);
-					return token;
-				}
-				else if (isReservedOperator(word))
+		int ch = cursor < (state == S_START ? stop : limit) ? (unsigned char)*cursor : EOF;
+		unsigned short transition = transitions[state][ch == EOF ? C_EOF : charClasses[ch]];
+		int next = transition & 0xFF;
+
+		switch (transition & 0xFF00)
+		{
+		case A_SHIFT:
+		case A_SKIP:
+		case A_LINE:
+		{
+			cursor++;
+			state = next;
+			break;
+		}
+
+		case A_ACCEPT:
+		{
+			cursor++;
+
+			token = createToken(accepting[next], (size_t)(start - base), (size_t)(cursor - start));
+			token.atom = internAtom(atoms, start, token.length);
+			scanning = 0;
+			break;
+		}
+
+		case A_RETRACT:
+		{
+			if (state == S_IDENT)
+			{
+				const KeywordEntry *keyword = findKeyword(start, (int)(cursor - start));
+
+				if (keyword != NULL)
 				{
-					Token *token = createToken(RESERVED_OPERATOR, "Reserved-operator", word, row, column);
-					insertTable(table, word, token);
-					return token;
+					token = createToken(keyword->kind, (size_t)(start - base), (size_t)(cursor - start));
+					// keywords are pre-seeded at their Keyword values, whatever
+					// letter case the source uses:
+					token.atom = keyword->keyword;
 				}
 				else
 				{
-					Token *token = createToken(IDENTIFIER, "Identifier", word, row, column);
-					insertTable(table, word, token);
-					return token;
+					token = createToken(KIND_IDENTIFIER, (size_t)(start - base), (size_t)(cursor - start));
+					token.atom = internAtom(atoms, start, token.length);
 				}
 			}
+			else
+			{
+				token = createToken(accepting[state], (size_t)(start - base), (size_t)(cursor - start));
+				token.atom = internAtom(atoms, start, token.length);
+			}
 
+			scanning = 0;
 			break;
 		}
 
-		// q2:
-		// handling integers and identifying possible real numbers:
-		case 2:
+		case A_ERR_CHAR:
 		{
-			if (ch >= '0' && ch <= '9')
-			{
-				addWord(&word, &size, ch);
-			}
-			else if (ch == SMB_DOT)
-			{
-				addWord(&word, &size, ch);
-				state = 3;
-			}
-			else if (ch >= 'a' && ch <= 'z' || ch >= 'A' && ch <= 'Z' || ch == SMB_UNDER)
+			// a character past ASCII is reported whole, once it is known to
+			// be valid UTF-8:
+			const char *end = ch < 0x80 ? cursor + 1 : kernels->utf8(cursor, cursor + utf8Length(cursor, limit));
+
+			if (end == cursor)
 			{
-				addWord(&word, &size, ch);
-				fprintf(stderr, ERR_INVALID_IDENTIFIER, word, row, column);
-				return NULL;
+				if (lexer->report)
+				{
+					Position position = sourcePosition(lexer, (size_t)(cursor - base));
+					fprintf(stderr, ERR_INVALID_UTF8, position.row, position.column + 1);
+				}
 			}
-			else
+			else if (lexer->report)
 			{
-				ungetc(ch, input);
-				column--;
-
-				Token *token = createToken(NUMBER, "Integer number", word, row, column);
-				insertTable(table, word, token);
-				return token;
+				Position position = sourcePosition(lexer, (size_t)(end - base));
+				fprintf(stderr, ERR_UNKOWN_CHARACTER, (int)(end - cursor), cursor, position.row, position.column);
 			}
 
+			token = createToken(KIND_ERROR, (size_t)(cursor - base), 0);
+			scanning = 0;
 			break;
 		}
 
-		// q3:
-		// handling real numbers:
-		case 3:
+		case A_ERR_UTF8:
 		{
-			if (ch >= '0' && ch <= '9')
+			if (lexer->report)
 			{
-				addWord(&word, &size, ch);
-			}
-			else
-			{
-				ungetc(ch, input);
-				column--;
-
-				Token *token = createToken(NUMBER, "Real number", word, row, column);
-				insertTable(table, word, token);
-				return token;
+				Position position = sourcePosition(lexer, (size_t)(cursor - base));
+				fprintf(stderr, ERR_INVALID_UTF8, position.row, position.column + 1);
 			}
 
+			token = createToken(KIND_ERROR, (size_t)(cursor - base), 0);
+			scanning = 0;
 			break;
 		}
 
-		// q4:
-		// handling relational operators:
-		case 4:
+		case A_ERR_IDENT:
 		{
-			if (ch == OP_EQU && (word[size - 1] == OP_GT || word[size - 1] == OP_LT))
+			if (lexer->report)
 			{
-				addWord(&word, &size, ch);
-			}
-			else
-			{
-				ungetc(ch, input);
-				column--;
-
-				Token *token = createToken(OPERATOR, "Relational Operator", word, row, column);
-				insertTable(table, word, token);
-				return token;
+				Position position = sourcePosition(lexer, (size_t)(cursor + 1 - base));
+				fprintf(stderr, ERR_INVALID_IDENTIFIER, (int)(cursor + 1 - start), start, position.row, position.column);
 			}
 
+			token = createToken(KIND_ERROR, (size_t)(cursor - base), 0);
+			scanning = 0;
 			break;
 		}
 
-		// q5:
-		// identifying assignment operators and symbols:
-		case 5:
+		case A_ERR_STRING:
 		{
-			if (ch == OP_EQU && word[size - 1] == SMB_COLON)
+			if (lexer->report)
 			{
-				addWord(&word, &size, ch);
-
-				Token *token = createToken(OPERATOR, "Assignment Operator", word, row, column);
-				insertTable(table, word, token);
-				return token;
+				// the new line that ends the string counts as its last column:
+				Position position = sourcePosition(lexer, (size_t)(cursor - base));
+				fprintf(stderr, ERR_STRING_NOT_CLOSED, position.row, position.column + (ch != EOF));
 			}
-			else
-			{
-				ungetc(ch, input);
-				column--;
 
-				Token *token = createToken(SYMBOL, "Symbol", word, row, column);
-				insertTable(table, word, token);
-				return token;
-			}
+			token = createToken(KIND_ERROR, (size_t)(cursor - base), 0);
+			scanning = 0;
+			break;
 		}
 
-		// q6:
-		// identifying strings:
-		case 6:
+		case A_ERR_COMMENT:
 		{
-			if (ch == SMB_SQT || ch == SMB_DQT)
+			if (lexer->report)
 			{
-				addWord(&word, &size, ch);
-				Token *token = createToken(STRING, "String", word, row, column);
-				insertTable(table, word, token);
-				return token;
-			}
-			else if (ch == END_OF_FILE || ch == NEW_LINE)
-			{
-				fprintf(stderr, ERR_STRING_NOT_CLOSED, row, column);
-				return NULL;
-			}
-			else
-			{
-				addWord(&word, &size, ch);
+				// reported where the comment opens:
+				Position position = sourcePosition(lexer, (size_t)(start - base));
+				fprintf(stderr, ERR_COMMENT_NOT_CLOSED, position.row, position.column + 1);
 			}
 
+			token = createToken(KIND_ERROR, (size_t)(cursor - base), 0);
+			scanning = 0;
 			break;
 		}
 
-		default:
+		case A_END:
 		{
-			fprintf(stderr, ERR_UNKOWN_STATE, row, column);
-			return NULL;
-		}
+			token = createToken(KIND_END_OF_FILE, (size_t)(cursor - base), 0);
+			scanning = 0;
+			break;
 		}
-	}
 
-	if (size > 0)
-	{
-		if (state == 1)
+		default:
 		{
-			if (isReservedWord(word))
+			if (lexer->report)
 			{
-				Token *token = createToken(RESERVED_WORD, "Reserved-word", word, row, column);
-				insertTable(table, word, token);
-			}
-			else if (isReservedType(word))
-			{
-				Token *token = createToken(RESERVED_TYPE, "Reserved-type", word, row, column);
-				insertTable(table, word, token);
-			}
-			else if (isReservedOperator(word))
-			{
-				Token *token = createToken(RESERVED_OPERATOR, "Reserved-operator", word, row, column);
-				insertTable(table, word, token);
-			}
-			else
-			{
-				Token *token = createToken(IDENTIFIER, "Identifier", word, row, column);
-				insertTable(table, word, token);
+				Position position = sourcePosition(lexer, (size_t)(cursor - base));
+				fprintf(stderr, ERR_UNKOWN_STATE, position.row, position.column);
 			}
+
+			token = createToken(KIND_ERROR, (size_t)(cursor - base), 0);
+			scanning = 0;
+			break;
 		}
-		else if (state == 2)
-		{
-			Token *token = createToken(NUMBER, "Integer number", word, row, column);
-			insertTable(table, word, token);
-		}
-		else if (state == 3)
-		{
-			Token *token = createToken(NUMBER, "Real number", word, row, column);
-			insertTable(table, word, token);
 		}
 	}
 
-	free(word);
-	Token *token = createToken(END_OF_FILE, "EOF", "EOF", row, column);
+	lexer->cursor = cursor;
+
 	return token;
 }
 
-static void addWord(char **word, int *size, const char ch)
+// the number of bytes a UTF-8 sequence claims from its lead byte, cut at the
+// end of the input:
+static size_t utf8Length(const char *cursor, const char *limit)
 {
-	*word = (char *)realloc(*word, sizeof(char) * (*size + 2));
-	(*word)[(*size)++] = ch;
-	(*word)[*size] = '\0';
-}
+	unsigned char lead = (unsigned char)*cursor;
+	size_t length = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : 2;
 
-static void removeWord(char **word, int *size)
-{
-	*word = (char *)realloc(*word, sizeof(char) * (*size));
-	(*word)[(*size)--] = '\0';
+	return length < (size_t)(limit - cursor) ? length : (size_t)(limit - cursor);
 }
 
-static int isValidIdentifier(const char *word)
+// the '*' of the first '*)' in a '(*' comment, or NULL if it is not closed:
+static const char *commentEnd(const char *cursor, const char *limit)
 {
-	if (word == NULL || !(word[0] == '_' || (word[0] >= 'a' && word[0] <= 'z') || (word[0] >= 'A' && word[0] <= 'Z')))
-		return 0;
-
-	for (int i = 1; word[i] != '\0'; i++)
+	while ((cursor = (const char *)memchr(cursor, OP_MUL, limit - cursor)) != NULL)
 	{
-		if (!(word[i] == '_' || (word[i] >= 'a' && word[i] <= 'z') || (word[i] >= 'A' && word[i] <= 'Z') || (word[i] >= '0' && word[i] <= '9')))
-			return 0;
+		if (cursor + 1 < limit && cursor[1] == SMB_CPA)
+			return cursor;
+
+		cursor++;
 	}
 
-	return 1;
+	return NULL;
 }
 
-static int isReservedWord(const char *word)
+// keywords indexed by a perfect hash of (length, first, second and last
+// character) folded to lower case; the multiplier was found by searching
+// for one that maps all 44 keywords to distinct slots out of 128:
+#define KEYWORD_HASH_MULTIPLIER 0xFECAAC3Bu
+#define KEYWORD_HASH_BITS 7
+#define KEYWORD_MIN_LENGTH 2
+#define KEYWORD_MAX_LENGTH 9
+
+static const KeywordEntry keywords[1 << KEYWORD_HASH_BITS] = {
+	[0] = {RESERVED_TYPE_REAL, 4, KIND_RESERVED_TYPE, KEYWORD_REAL},
+	[2] = {RESERVED_TYPE_LONGINT, 7, KIND_RESERVED_TYPE, KEYWORD_LONGINT},
+	[7] = {RESERVED_WORD_IN, 2, KIND_RESERVED_WORD, KEYWORD_IN},
+	[10] = {RESERVED_WORD_RECORD, 6, KIND_RESERVED_WORD, KEYWORD_RECORD},
+	[11] = {RESERVED_OP_NOT, 3, KIND_RESERVED_OPERATOR, KEYWORD_NOT},
+	[15] = {RESERVED_WORD_TYPE, 4, KIND_RESERVED_WORD, KEYWORD_TYPE},
+	[19] = {RESERVED_WORD_SET, 3, KIND_RESERVED_WORD, KEYWORD_SET},
+	[25] = {RESERVED_WORD_CASE, 4, KIND_RESERVED_WORD, KEYWORD_CASE},
+	[26] = {RESERVED_TYPE_BYTE, 4, KIND_RESERVED_TYPE, KEYWORD_BYTE},
+	[40] = {RESERVED_WORD_OF, 2, KIND_RESERVED_WORD, KEYWORD_OF},
+	[42] = {RESERVED_OP_MOD, 3, KIND_RESERVED_OPERATOR, KEYWORD_MOD},
+	[43] = {RESERVED_WORD_IF, 2, KIND_RESERVED_WORD, KEYWORD_IF},
+	[44] = {RESERVED_WORD_UNTIL, 5, KIND_RESERVED_WORD, KEYWORD_UNTIL},
+	[45] = {RESERVED_WORD_ARRAY, 5, KIND_RESERVED_WORD, KEYWORD_ARRAY},
+	[52] = {RESERVED_TYPE_CURRENCY, 8, KIND_RESERVED_TYPE, KEYWORD_CURRENCY},
+	[58] = {RESERVED_WORD_WITH, 4, KIND_RESERVED_WORD, KEYWORD_WITH},
+	[59] = {RESERVED_WORD_DOWNTO, 6, KIND_RESERVED_WORD, KEYWORD_DOWNTO},
+	[60] = {RESERVED_WORD_TO, 2, KIND_RESERVED_WORD, KEYWORD_TO},
+	[62] = {RESERVED_TYPE_CHAR, 4, KIND_RESERVED_TYPE, KEYWORD_CHAR},
+	[65] = {RESERVED_TYPE_WORD, 4, KIND_RESERVED_TYPE, KEYWORD_WORD},
+	[66] = {RESERVED_WORD_FILE, 4, KIND_RESERVED_WORD, KEYWORD_FILE},
+	[69] = {RESERVED_WORD_DO, 2, KIND_RESERVED_WORD, KEYWORD_DO},
+	[74] = {RESERVED_WORD_END, 3, KIND_RESERVED_WORD, KEYWORD_END},
+	[76] = {RESERVED_OP_AND, 3, KIND_RESERVED_OPERATOR, KEYWORD_AND},
+	[77] = {RESERVED_WORD_CONST, 5, KIND_RESERVED_WORD, KEYWORD_CONST},
+	[79] = {RESERVED_WORD_VAR, 3, KIND_RESERVED_WORD, KEYWORD_VAR},
+	[82] = {RESERVED_TYPE_EXTENDED, 8, KIND_RESERVED_TYPE, KEYWORD_EXTENDED},
+	[83] = {RESERVED_WORD_BEGIN, 5, KIND_RESERVED_WORD, KEYWORD_BEGIN},
+	[85] = {RESERVED_WORD_PROGRAM, 7, KIND_RESERVED_WORD, KEYWORD_PROGRAM},
+	[86] = {RESERVED_TYPE_SHORTINT, 8, KIND_RESERVED_TYPE, KEYWORD_SHORTINT},
+	[87] = {RESERVED_TYPE_COMP, 4, KIND_RESERVED_TYPE, KEYWORD_COMP},
+	[91] = {RESERVED_WORD_THEN, 4, KIND_RESERVED_WORD, KEYWORD_THEN},
+	[94] = {RESERVED_TYPE_DOUBLE, 6, KIND_RESERVED_TYPE, KEYWORD_DOUBLE},
+	[95] = {RESERVED_WORD_PROCEDURE, 9, KIND_RESERVED_WORD, KEYWORD_PROCEDURE},
+	[100] = {RESERVED_WORD_FOR, 3, KIND_RESERVED_WORD, KEYWORD_FOR},
+	[108] = {RESERVED_WORD_REPEAT, 6, KIND_RESERVED_WORD, KEYWORD_REPEAT},
+	[112] = {RESERVED_WORD_WHILE, 5, KIND_RESERVED_WORD, KEYWORD_WHILE},
+	[113] = {RESERVED_OP_OR, 2, KIND_RESERVED_OPERATOR, KEYWORD_OR},
+	[114] = {RESERVED_WORD_ELSE, 4, KIND_RESERVED_WORD, KEYWORD_ELSE},
+	[115] = {RESERVED_TYPE_INTEGER, 7, KIND_RESERVED_TYPE, KEYWORD_INTEGER},
+	[117] = {RESERVED_TYPE_SINGLE, 6, KIND_RESERVED_TYPE, KEYWORD_SINGLE},
+	[124] = {RESERVED_TYPE_STRING, 6, KIND_RESERVED_TYPE, KEYWORD_STRING},
+	[126] = {RESERVED_WORD_GOTO, 4, KIND_RESERVED_WORD, KEYWORD_GOTO},
+	[127] = {RESERVED_WORD_FUNCTION, 8, KIND_RESERVED_WORD, KEYWORD_FUNCTION},
+};
+
+static const KeywordEntry *findKeyword(const char *word, int length)
 {
-	if (word == NULL)
-		return 0;
-
-	static const char *reserverdWords[] = {
-		RESERVED_WORD_PROGRAM, RESERVED_WORD_VAR, RESERVED_WORD_BEGIN,
-		RESERVED_WORD_END, RESERVED_WORD_IF, RESERVED_WORD_ELSE,
-		RESERVED_WORD_THEN, RESERVED_WORD_DO, RESERVED_WORD_WHILE,
-		RESERVED_WORD_FOR, RESERVED_WORD_TO, RESERVED_WORD_DOWNTO,
-		RESERVED_WORD_REPEAT, RESERVED_WORD_UNTIL, RESERVED_WORD_CASE,
-		RESERVED_WORD_OF, RESERVED_WORD_FUNCTION, RESERVED_WORD_PROCEDURE,
-		RESERVED_WORD_ARRAY, RESERVED_WORD_RECORD, RESERVED_WORD_CONST,
-		RESERVED_WORD_TYPE, RESERVED_WORD_FILE, RESERVED_WORD_SET,
-		RESERVED_WORD_GOTO, RESERVED_WORD_WITH, RESERVED_WORD_IN};
-
-	static const int reservedWordsSize = sizeof(reserverdWords) / sizeof(char *);
-
-	for (int size = 0; size < reservedWordsSize; size++)
+	if (length < KEYWORD_MIN_LENGTH || length > KEYWORD_MAX_LENGTH)
+		return NULL;
+
+	// identifiers only hold letters, digits and '_', for which setting bit
+	// 0x20 folds upper case letters and leaves everything else unmatched:
+	unsigned int key = (unsigned char)(word[0] | 0x20) |
+					   (unsigned char)(word[1] | 0x20) << 8 |
+					   (unsigned char)(word[length - 1] | 0x20) << 16 |
+					   (unsigned int)length << 24;
+	const KeywordEntry *keyword = &keywords[(key * KEYWORD_HASH_MULTIPLIER) >> (32 - KEYWORD_HASH_BITS)];
+
+	if (keyword->length != length)
+		return NULL;
+
+	char folded[KEYWORD_MAX_LENGTH];
+
+	for (int index = 0; index < length; index++)
 	{
-		if (strcmp(word, reserverdWords[size]) == 0)
-			return 1;
+		folded[index] = word[index] | 0x20;
 	}
 
-	return 0;
+	return memcmp(folded, keyword->text, length) == 0 ? keyword : NULL;
 }
 
-static int isReservedType(const char *word)
+#define SYMBOL_INITIAL_SLOTS 64
+
+Table *initTable()
 {
-	if (word == NULL)
-		return 0;
+	Table *table = (Table *)malloc(sizeof(Table));
 
-	static const char *reserverdWords[] = {
-		RESERVED_TYPE_INTEGER, RESERVED_TYPE_REAL,
-		RESERVED_TYPE_CHAR, RESERVED_TYPE_STRING,
-		RESERVED_TYPE_DOUBLE, RESERVED_TYPE_BYTE,
-		RESERVED_TYPE_WORD, RESERVED_TYPE_LONGINT,
-		RESERVED_TYPE_SHORTINT, RESERVED_TYPE_SINGLE,
-		RESERVED_TYPE_EXTENDED, RESERVED_TYPE_COMP,
-		RESERVED_TYPE_CURRENCY};
+	table->tokens = createTokenStream();
+	table->symbolCapacity = SYMBOL_INITIAL_SLOTS;
+	table->symbolCount = 0;
+	table->symbols = (Symbol *)calloc(table->symbolCapacity, sizeof(Symbol));
+	table->atoms = createAtomTable();
 
-	static const int reservedWordsSize = sizeof(reserverdWords) / sizeof(char *);
+	return table;
+}
 
-	for (int size = 0; size < reservedWordsSize; size++)
-	{
-		if (strcmp(word, reserverdWords[size]) == 0)
-			return 1;
-	}
+void clearTable(Table *table)
+{
+	clearTokenStream(table->tokens);
+
+	// the index keeps its size, so a reused table does not grow again:
+	if (table->symbolCount > 0)
+		memset(table->symbols, 0, table->symbolCapacity * sizeof(Symbol));
 
-	return 0;
+	table->symbolCount = 0;
 }
 
-static int isReservedOperator(const char *word)
+void freeTable(Table *table)
 {
-	if (word == NULL)
-		return 0;
+	freeTokenStream(table->tokens);
+	freeAtomTable(table->atoms);
+	free(table->symbols);
+	free(table);
+}
 
-	static const char *reserverdWords[] = {
-		RESERVED_OP_NOT, RESERVED_OP_AND, RESERVED_OP_OR, RESERVED_OP_MOD};
+// atoms are dense small integers, so they are scrambled with the murmur3
+// finalizer before being reduced to a slot:
+static Symbol *findSymbol(Symbol *symbols, size_t capacity, Atom atom)
+{
+	uint32_t hash = atom;
 
-	static const int reservedWordsSize = sizeof(reserverdWords) / sizeof(char *);
+	hash ^= hash >> 16;
+	hash *= 0x85EBCA6Bu;
+	hash ^= hash >> 13;
+	hash *= 0xC2B2AE35u;
+	hash ^= hash >> 16;
 
-	for (int size = 0; size < reservedWordsSize; size++)
-	{
-		if (strcmp(word, reserverdWords[size]) == 0)
-			return 1;
-	}
+	size_t mask = capacity - 1, slot = hash & mask;
+
+	while (symbols[slot].atom != ATOM_NONE && symbols[slot].atom != atom)
+		slot = (slot + 1) & mask;
 
-	return 0;
+	return &symbols[slot];
 }
 
-Table *initTable()
+static void growSymbols(Table *table)
 {
-	Table *table = (Table *)malloc(sizeof(Table));
-	table->entries = (Entry **)malloc(sizeof(Entry *));
+	size_t capacity = table->symbolCapacity * 2;
+	Symbol *symbols = (Symbol *)calloc(capacity, sizeof(Symbol));
 
-	for (int size = 0; size < sizeof(table->entries) / sizeof(Entry *); size++)
+	if (symbols == NULL)
 	{
-		table->entries[size] = NULL;
+		fprintf(stderr, ERR_MEMORY_ALLOCATION_FAILED);
+		exit(EXIT_FAILURE);
 	}
 
-	table->entryCount = 0;
+	for (size_t slot = 0; slot < table->symbolCapacity; slot++)
+	{
+		if (table->symbols[slot].atom != ATOM_NONE)
+			*findSymbol(symbols, capacity, table->symbols[slot].atom) = table->symbols[slot];
+	}
 
-	return table;
+	free(table->symbols);
+	table->symbols = symbols;
+	table->symbolCapacity = capacity;
+}
+
+static void insertTable(Table *table, Token *token)
+{
+	token->index = appendToken(table->tokens, token);
+
+	if (token->atom != ATOM_NONE)
+		addSymbol(table, token->atom, token->index, 1);
 }
 
-static unsigned int hash(char *key, int tableSize)
+static void addSymbol(Table *table, Atom atom, size_t first, uint32_t count)
 {
-	unsigned int hash = 0;
+	Symbol *symbol = findSymbol(table->symbols, table->symbolCapacity, atom);
 
-	while (*key)
+	if (symbol->atom != ATOM_NONE)
 	{
-		hash = (hash << 5) + *key++;
+		symbol->count += count;
+
+		// occurrences spliced in by an edit may come before the known one:
+		if (first < symbol->first)
+			symbol->first = first;
+
+		return;
 	}
 
-	return hash % tableSize;
+	// keep the load factor at or below one half:
+	if ((table->symbolCount + 1) * 2 > table->symbolCapacity)
+	{
+		growSymbols(table);
+		symbol = findSymbol(table->symbols, table->symbolCapacity, atom);
+	}
+
+	symbol->atom = atom;
+	symbol->count = count;
+	symbol->first = first;
+	table->symbolCount++;
 }
 
-static void insertTable(Table *table, char *key, Token *token)
+static void spliceTable(Table *table, size_t from, size_t removed, const TokenStream *replacement, ptrdiff_t offsetDelta)
 {
-	unsigned int index = hash(key, sizeof(table->entries) / sizeof(Entry *));
-	Entry *entry = (Entry *)malloc(sizeof(Entry));
-
-	entry->key = key;
-	entry->token = token;
-	entry->next = NULL;
-	entry->prev = NULL;
+	size_t added = replacement->count;
 
-	if (table->entries[index] == NULL)
+	// a symbol whose first occurrence is replaced finds its next one when
+	// it is searched for:
+	for (size_t index = from; index < from + removed; index++)
 	{
-		table->entries[index] = entry;
+		Token token = streamToken(table->tokens, index);
+
+		if (token.atom == ATOM_NONE)
+			continue;
+
+		Symbol *symbol = findSymbol(table->symbols, table->symbolCapacity, token.atom);
+		symbol->count--;
+
+		if (symbol->first >= from && symbol->first < from + removed)
+			symbol->first = TOKEN_NONE;
 	}
-	else
+
+	// first occurrences after the range move with their tokens:
+	if (added != removed)
 	{
-		Entry *current = table->entries[index];
-		while (current->next != NULL)
+		for (size_t slot = 0; slot < table->symbolCapacity; slot++)
 		{
-			current = current->next;
+			Symbol *symbol = &table->symbols[slot];
+
+			if (symbol->atom != ATOM_NONE && symbol->first != TOKEN_NONE && symbol->first >= from + removed)
+				symbol->first = symbol->first - removed + added;
 		}
-		current->next = entry;
-		entry->prev = current;
 	}
 
-	table->entryCount++;
+	spliceTokens(table->tokens, from, removed, replacement, offsetDelta);
+
+	for (size_t index = 0; index < added; index++)
+	{
+		Token token = streamToken(replacement, index);
+
+		if (token.atom != ATOM_NONE)
+			addSymbol(table, token.atom, from + index, 1);
+	}
 }
 
-Token *searchTable(Table *table, char *key)
+size_t searchTable(Table *table, const char *key)
 {
-	unsigned int index = hash(key, sizeof(table->entries) / sizeof(Entry *));
-	Entry *entry = table->entries[index];
+	size_t length = strlen(key);
+	const KeywordEntry *keyword = findKeyword(key, (int)length);
+	Atom atom = keyword != NULL ? (Atom)keyword->keyword : findAtom(table->atoms, key, length);
 
-	while (entry != NULL)
-	{
-		if (strcmp(entry->key, key) == 0)
-		{
-			return entry->token;
-		}
+	if (atom == ATOM_NONE)
+		return TOKEN_NONE;
 
-		entry = entry->next;
+	Symbol *symbol = findSymbol(table->symbols, table->symbolCapacity, atom);
+
+	if (symbol->atom != atom || symbol->count == 0)
+		return TOKEN_NONE;
+
+	// the first occurrence was edited away, so the next one is looked up:
+	for (size_t index = 0; symbol->first == TOKEN_NONE; index++)
+	{
+		if (streamToken(table->tokens, index).atom == atom)
+			symbol->first = index;
 	}
 
-	return NULL;
+	return symbol->first;
 }
 
-static Token *createToken(TokenType type, char *name, char *word, int row, int column)
+Token createToken(TokenKind kind, size_t offset, size_t length)
 {
-	Token *token = (Token *)malloc(sizeof(Token));
+	Token token;
 
-	token->type = type;
-	token->name = name;
-	token->word = word;
-	token->row = row;
-	token->column = column;
-	token->next = NULL;
+	token.type = kinds[kind].type;
+	token.name = kinds[kind].name;
+	token.offset = offset;
+	token.length = length;
+	token.atom = ATOM_NONE;
+	token.kind = kind;
+	token.index = TOKEN_NONE;
 
 	return token;
-}
\ No newline at end of file
+}
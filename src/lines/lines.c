@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../includes/lines.h"
+#include "../includes/scan.h"
+#include "../includes/errors.h"
+
+// the source is scanned in blocks, so the room reserved for the line starts
+// of a block never exceeds its size:
+#define LINE_BLOCK (1 << 16)
+
+static void reserveLines(LineIndex *lines, size_t count);
+
+LineIndex *createLineIndex(void)
+{
+	LineIndex *lines = (LineIndex *)malloc(sizeof(LineIndex));
+
+	if (lines == NULL)
+	{
+		fprintf(stderr, ERR_MEMORY_ALLOCATION_FAILED);
+		exit(EXIT_FAILURE);
+	}
+
+	lines->starts = NULL;
+	lines->count = 0;
+	lines->capacity = 0;
+	lines->scanned = 0;
+
+	reserveLines(lines, 1);
+	lines->starts[lines->count++] = 0;
+
+	return lines;
+}
+
+void freeLineIndex(LineIndex *lines)
+{
+	if (lines == NULL)
+		return;
+
+	free(lines->starts);
+	free(lines);
+}
+
+void indexLines(LineIndex *lines, const char *text, size_t size)
+{
+	const ScanKernels *kernels = activeScanKernels();
+
+	while (lines->scanned < size)
+	{
+		size_t block = size - lines->scanned < LINE_BLOCK ? size - lines->scanned : LINE_BLOCK;
+
+		reserveLines(lines, lines->count + block);
+		lines->count += kernels->lineStarts(text + lines->scanned, text + lines->scanned + block, lines->scanned, lines->starts + lines->count);
+		lines->scanned += block;
+	}
+}
+
+void truncateLines(LineIndex *lines, size_t offset)
+{
+	if (offset >= lines->scanned)
+		return;
+
+	// a line starting right after the offset follows a new line that may
+	// have changed:
+	while (lines->count > 1 && lines->starts[lines->count - 1] > offset)
+		lines->count--;
+
+	lines->scanned = lines->starts[lines->count - 1];
+}
+
+Position linePosition(const LineIndex *lines, const char *text, size_t offset)
+{
+	size_t low = 0, high = lines->count;
+
+	// the row is the last line that starts at or before the offset:
+	while (high - low > 1)
+	{
+		size_t middle = low + (high - low) / 2;
+
+		if (lines->starts[middle] <= offset)
+			low = middle;
+		else
+			high = middle;
+	}
+
+	// columns count characters: the ASCII part of the row is skipped at
+	// once, and past it only the bytes that begin a UTF-8 sequence count:
+	const char *start = text + lines->starts[low], *end = text + offset;
+	const char *wide = activeScanKernels()->ascii(start, end);
+	Position position = {low + 1, (size_t)(wide - start)};
+
+	for (; wide < end; wide++)
+		position.column += ((unsigned char)*wide & 0xC0) != 0x80;
+
+	return position;
+}
+
+static void reserveLines(LineIndex *lines, size_t count)
+{
+	if (count <= lines->capacity)
+		return;
+
+	size_t capacity = lines->capacity ? lines->capacity : LINE_BLOCK;
+
+	while (capacity < count)
+		capacity *= 2;
+
+	size_t *starts = (size_t *)realloc(lines->starts, capacity * sizeof(size_t));
+
+	if (starts == NULL)
+	{
+		fprintf(stderr, ERR_MEMORY_ALLOCATION_FAILED);
+		exit(EXIT_FAILURE);
+	}
+
+	lines->starts = starts;
+	lines->capacity = capacity;
+}
@@ -1,12 +1,22 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
+#include "includes/document.h"
 #include "includes/lexer.h"
 #include "includes/parser.h"
+#include "includes/scan.h"
+#include "includes/source.h"
+#include "includes/stream.h"
 
-static void saveFile(Token *token);
+static FILE *output;
+
+static void saveFile(const LexerContext *lexer, const Token *token, Position position);
 static char *createOutputPath(const char *inputName);
+static int benchLexer(const char *inputName, int iterations, int threads);
+static int parseFile(const char *inputName);
+static int editFile(const char *inputName, size_t offset, size_t removed, const char *text);
 
 /**
  * @file main.c
@@ -16,6 +26,11 @@ static char *createOutputPath(const char *inputName);
  * It supports the following command-line arguments:
  * - `--help` or `-h`: Displays usage information.
  * - `--file <file>` or `-f <file>`: Specifies the Pascal file to be analyzed.
+ * - `--threads <n>`: Lexes the file given with `--file` on n threads.
+ * - `--parse <file>`: Checks the syntax of a file, lexing it while it is parsed.
+ * - `--bench <file> [iterations] [threads]`: Measures the lexer throughput on a file.
+ * - `--edit <file> <offset> <length> <text>`: Measures the time to update the tokens
+ *   and tree of a file after replacing length characters at offset with text.
  *
  * The program checks for valid arguments and file extensions, opens the specified file,
  * and performs to analyse it.
@@ -36,9 +51,46 @@ int main(int argc, char **argv)
 		if (strcmp(argv[1], "--help") == 0 || strcmp(argv[1], "-h") == 0)
 		{
 			printf("Usage:\n\t--file <file>\t\tReads a pascal file and do the lexical analysis\n");
+			printf("\t--threads <n>\t\tLexes the file given with --file on n threads\n");
+			printf("\t--parse <file>\t\tChecks the syntax of a pascal file while it is lexed\n");
+			printf("\t--bench <file> [n] [t]\tMeasures the lexer throughput over n runs on t threads\n");
+			printf("\t--edit <file> <o> <l> <text>\tMeasures the update after replacing l characters at o with text\n");
 			return 0;
 		}
 
+		if (strcmp(argv[1], "--parse") == 0)
+		{
+			if (argv[2] == NULL)
+			{
+				printf("File not specified:\n\t--parse <file>\n");
+				return 1;
+			}
+
+			return parseFile(argv[2]);
+		}
+
+		if (strcmp(argv[1], "--bench") == 0)
+		{
+			if (argv[2] == NULL)
+			{
+				printf("File not specified:\n\t--bench <file> [iterations]\n");
+				return 1;
+			}
+
+			return benchLexer(argv[2], argv[3] ? atoi(argv[3]) : 10, argv[3] && argv[4] ? atoi(argv[4]) : 1);
+		}
+
+		if (strcmp(argv[1], "--edit") == 0)
+		{
+			if (argv[2] == NULL || argv[3] == NULL || argv[4] == NULL || argv[5] == NULL)
+			{
+				printf("Edit not specified:\n\t--edit <file> <offset> <length> <text>\n");
+				return 1;
+			}
+
+			return editFile(argv[2], strtoull(argv[3], NULL, 10), strtoull(argv[4], NULL, 10), argv[5]);
+		}
+
 		if (strcmp(argv[1], "--file") != 0 || strcmp(argv[1], "-f") != 0 && argv[2] == NULL)
 		{
 			printf("File not specified:\n\t--file <file>\n");
@@ -56,37 +108,35 @@ int main(int argc, char **argv)
 			else
 			{
 				char *inputName = argv[2];
+				int threads = argv[3] && strcmp(argv[3], "--threads") == 0 && argv[4] ? atoi(argv[4]) : 1;
 				char *outputPath = createOutputPath(inputName);
-				input = fopen(inputName, "r");
+				Source *source = openSource(inputName);
 
-				if (input == NULL)
+				if (source == NULL)
 				{
 					printf("File not found:\n\t--file <file>\n");
 					return 1;
 				}
 				else
 				{
-					Token *token;
-					Table *table = initTable();
+					Token token;
+					LexerContext *lexer = createLexer(source);
 					output = fopen(outputPath, "w");
 
-					while ((token = lexerAnalysis(table)) && token->type != ERROR && token->type != END_OF_FILE && token != NULL);
-
-					free(token);
-
-					Entry *entry = table->entries[0];
+					lexerAnalysisParallel(lexer, threads);
 
-					while (entry != NULL)
+					for (size_t index = 0; index < lexer->table->tokens->count; index++)
 					{
-						printf("<%d, %s, '%s'> : <%d, %d>\n", entry->token->type, entry->token->name, entry->token->word, entry->token->row, entry->token->column);
-						saveFile(entry->token);
-						entry = entry->next;
+						token = streamToken(lexer->table->tokens, index);
+						Position position = tokenPosition(lexer, &token);
+						printf("<%d, %s, '%.*s'> : <%zu, %zu>\n", token.type, token.name, (int)token.length, tokenLexeme(lexer, &token), position.row, position.column);
+						saveFile(lexer, &token, position);
 					}
 
-					ASTNode *ast = parseTokens(table);
+					ASTNode *ast = parseTokens(lexer);
 
-					free(table);
-					fclose(input);
+					freeLexer(lexer);
+					closeSource(source);
 					fclose(output);
 				}
 			}
@@ -97,9 +147,9 @@ int main(int argc, char **argv)
 }
 
 
-static void saveFile(Token *token)
+static void saveFile(const LexerContext *lexer, const Token *token, Position position)
 {
-	fprintf(output, "<%d, %s, '%s'> : <%d, %d>\n", token->type, token->name, token->word, token->row, token->column);
+	fprintf(output, "<%d, %s, '%.*s'> : <%zu, %zu>\n", token->type, token->name, (int)token->length, tokenLexeme(lexer, token), position.row, position.column);
 }
 
 static char *createOutputPath(const char *inputName)
@@ -132,4 +182,110 @@ static char *createOutputPath(const char *inputName)
 
 	free(outputName);
 	return outputPath;
-}
\ No newline at end of file
+}
+
+// lexes the whole file repeatedly with each available scanning kernel and
+// reports the throughput, so kernels can be compared on the same corpus:
+static int benchLexer(const char *inputName, int iterations, int threads)
+{
+	static const ScanLevel levels[] = {SCAN_SCALAR, SCAN_SSE2, SCAN_AVX2};
+	Source *source = openSource(inputName);
+
+	if (source == NULL)
+	{
+		printf("File not found:\n\t--bench <file>\n");
+		return 1;
+	}
+
+	iterations = iterations > 0 ? iterations : 1;
+
+	for (size_t level = 0; level < sizeof(levels) / sizeof(levels[0]); level++)
+	{
+		if (!selectScanKernels(levels[level]))
+			continue;
+
+		size_t tokens = 0;
+		struct timespec start, stop;
+
+		// wall time, as processor time would add up the threads:
+		timespec_get(&start, TIME_UTC);
+
+		// every pass fills a table with all tokens of the file, as the
+		// --file mode does:
+		for (int iteration = 0; iteration < iterations; iteration++)
+		{
+			LexerContext *lexer = createLexer(source);
+
+			lexerAnalysisParallel(lexer, threads);
+			tokens = lexer->table->tokens->count;
+
+			freeLexer(lexer);
+		}
+
+		timespec_get(&stop, TIME_UTC);
+
+		double seconds = (double)(stop.tv_sec - start.tv_sec) + (double)(stop.tv_nsec - start.tv_nsec) / 1e9;
+		double bytes = (double)source->size * iterations;
+
+		printf("%-8s %10.3f GB/s  %10.3f Mtokens/s  (%zu tokens, %zu bytes)\n", activeScanKernels()->name,
+			   seconds > 0 ? bytes / seconds / 1e9 : 0.0, seconds > 0 ? (double)tokens * iterations / seconds / 1e6 : 0.0,
+			   tokens, source->size);
+	}
+
+	selectScanKernels(SCAN_AUTO);
+	closeSource(source);
+
+	return 0;
+}
+
+// parses a file with tokens pulled from the lexer on demand: no token table
+// is built and statement trees are dropped once checked, so memory does not
+// grow with the size of the file. Syntax errors exit with a failure status:
+static int parseFile(const char *inputName)
+{
+	Source *source = openSource(inputName);
+
+	if (source == NULL)
+	{
+		printf("File not found:\n\t--parse <file>\n");
+		return 1;
+	}
+
+	LexerContext *lexer = createLexer(source);
+
+	ASTNode *ast = parseSource(lexer, 0);
+
+	freeNode(ast);
+	freeLexer(lexer);
+	closeSource(source);
+
+	return 0;
+}
+
+// applies one edit to a file loaded as a document and reports how long the
+// tokens and the tree took to catch up with it:
+static int editFile(const char *inputName, size_t offset, size_t removed, const char *text)
+{
+	Document *document = openDocument(inputName);
+
+	if (document == NULL)
+	{
+		printf("File not found:\n\t--edit <file>\n");
+		return 1;
+	}
+
+	struct timespec start, stop;
+
+	timespec_get(&start, TIME_UTC);
+	int updated = editDocument(document, offset, removed, text, strlen(text));
+	timespec_get(&stop, TIME_UTC);
+
+	double seconds = (double)(stop.tv_sec - start.tv_sec) + (double)(stop.tv_nsec - start.tv_nsec) / 1e9;
+
+	printf("%s in %.3f ms  (%zu tokens, %zu bytes)\n", updated ? "Updated" : "Not updated", seconds * 1e3,
+		   document->lexer->table->tokens->count, document->size);
+
+	closeDocument(document);
+
+	return updated ? 0 : 1;
+}
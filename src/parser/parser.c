@@ -3,11 +3,13 @@
 #include <string.h>
 
 #include "../includes/lexer.h"
+#include "../includes/atoms.h"
+#include "../includes/stream.h"
 #include "../includes/parser.h"
 #include "../includes/errors.h"
 #include "../includes/tokens.h"
 
-ASTNode *createNode(int type, char *value)
+ASTNode *createNode(int type, const char *value, size_t length)
 {
     ASTNode *node = (ASTNode *)malloc(sizeof(ASTNode));
 
@@ -19,35 +21,181 @@ ASTNode *createNode(int type, char *value)
 
     node->type = type;
     node->value = value;
+    node->length = length;
+    node->atom = ATOM_NONE;
     node->left = NULL;
     node->right = NULL;
+    node->next = NULL;
+    node->parent = NULL;
 
     return node;
 }
 
 void freeNode(ASTNode *node)
 {
-    if (node)
+    // statements of a block are walked in a loop, as a block may hold too
+    // many of them to recurse into:
+    while (node)
     {
-        if (node->value)
-        {
-            free(node->value);
-        }
+        ASTNode *next = node->next;
 
         freeNode(node->left);
         freeNode(node->right);
         free(node);
+        node = next;
+    }
+}
+
+// returns the token at the given index of the input. In pull mode the
+// lexer is asked for tokens until the index is reached, and only the last
+// PARSER_LOOKAHEAD of them are kept. Tokens past the end of the input read as
+// an end of file placed at the last token, so running out of input is
+// reported like any unexpected token:
+static Token tokenAt(Parser *parser, size_t index)
+{
+    if (parser->tokens != NULL)
+    {
+        const TokenStream *tokens = parser->tokens;
+
+        if (index < tokens->count)
+            return streamToken(tokens, index);
+
+        if (tokens->count > 0)
+            parser->last = streamToken(tokens, tokens->count - 1);
+    }
+    else
+    {
+        while (parser->pulled <= index && !parser->finished)
+        {
+            Token token = nextToken(parser->lexer);
+
+            if (token.type == END_OF_FILE || token.type == ERROR)
+            {
+                parser->finished = 1;
+                break;
+            }
+
+            token.index = parser->pulled++;
+            parser->lookahead[token.index & (PARSER_LOOKAHEAD - 1)] = token;
+            parser->last = token;
+        }
+
+        if (index < parser->pulled)
+            return parser->lookahead[index & (PARSER_LOOKAHEAD - 1)];
+    }
+
+    Token end = createToken(KIND_END_OF_FILE, parser->last.offset + parser->last.length, 0);
+    end.index = index;
+
+    return end;
+}
+
+static Token peek(Parser *parser, size_t k)
+{
+    return tokenAt(parser, parser->position + k);
+}
+
+static void advance(Parser *parser)
+{
+    // the tags are only set once the whole parse has succeeded, so a failed
+    // reparse leaves the tags of the tokens as they were:
+    if (parser->tags != NULL)
+    {
+        size_t index = parser->position - parser->tagFrom;
+
+        if (index == parser->tagCapacity)
+        {
+            parser->tagCapacity *= 2;
+            parser->tags = (ASTNode **)realloc(parser->tags, parser->tagCapacity * sizeof(ASTNode *));
+
+            if (!parser->tags)
+            {
+                fprintf(stderr, ERR_MEMORY_ALLOCATION_FAILED);
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        parser->tags[index] = parser->statement;
+    }
+
+    parser->position++;
+}
+
+static int hasNext(Parser *parser, const Token *token)
+{
+    return tokenAt(parser, token->index + 1).type != END_OF_FILE;
+}
+
+static void initParser(Parser *parser, const TokenStream *tokens, LexerContext *lexer, int keepTree)
+{
+    parser->tokens = tokens;
+    parser->position = 0;
+    parser->keepTree = keepTree;
+    parser->lexer = lexer;
+    parser->pulled = 0;
+    parser->finished = 0;
+    parser->last = createToken(KIND_END_OF_FILE, 0, 0);
+    parser->statement = NULL;
+    parser->tags = NULL;
+}
+
+// makes the parser record the statement consuming each token from its
+// current position on:
+static void startTags(Parser *parser)
+{
+    parser->tagFrom = parser->position;
+    parser->tagCapacity = 64;
+    parser->tags = (ASTNode **)malloc(parser->tagCapacity * sizeof(ASTNode *));
+
+    if (!parser->tags)
+    {
+        fprintf(stderr, ERR_MEMORY_ALLOCATION_FAILED);
+        exit(EXIT_FAILURE);
     }
 }
 
-static int isValidNumber(const char *str)
+// tags the tokens consumed with the statements recorded for them, or only
+// drops the record if the parse is not kept:
+static void endTags(Parser *parser, TokenStream *tokens, int keep)
+{
+    for (size_t index = parser->tagFrom; keep && index < parser->position; index++)
+        setTokenTag(tokens, index, parser->tags[index - parser->tagFrom]);
+
+    free(parser->tags);
+    parser->tags = NULL;
+}
+
+// the nodes of the statements being parsed are nested through their parent,
+// and tokens consumed until closeStatement are tagged with the node:
+static void openStatement(Parser *parser, ASTNode *node)
+{
+    node->parent = parser->statement;
+    parser->statement = node;
+}
+
+static void closeStatement(Parser *parser, ASTNode *node)
+{
+    parser->statement = node->parent;
+}
+
+// the value of a node is the interned lexeme, which outlives edits to the
+// text the token was read from:
+static ASTNode *createTokenNode(Parser *parser, const Token *token)
+{
+    ASTNode *node = createNode(token->type, atomName(parser->lexer->table->atoms, token->atom), token->length);
+    node->atom = token->atom;
+
+    return node;
+}
+
+static int isValidNumber(const char *str, size_t length)
 {
     int hasDecimalPoint = 0;
 
-    if (*str == '\0')
+    if (length == 0)
         return 0;
 
-    while (*str)
+    for (const char *end = str + length; str < end;)
     {
         if (*str == '.')
         {
@@ -65,235 +213,248 @@ static int isValidNumber(const char *str)
     return 1;
 }
 
-ASTNode *parseConditional(Table *table, Entry **currentEntry)
+ASTNode *parseConditional(Parser *parser)
 {
-    Entry *entry = *currentEntry;
+    Token token = peek(parser, 0);
 
-    if (entry->token->type != RESERVED_WORD || strcmp(entry->token->word, RESERVED_WORD_IF) != 0)
+    if (token.atom != KEYWORD_IF)
     {
-        fprintf(stderr, ERR_EXPECTED_IF, entry->token->row, entry->token->column);
+        Position position = tokenPosition(parser->lexer, &token);
+        fprintf(stderr, ERR_EXPECTED_IF, position.row, position.column);
         exit(EXIT_FAILURE);
     }
 
-    ASTNode *ifNode = createNode(entry->token->type, entry->token->word);
+    ASTNode *ifNode = createTokenNode(parser, &token);
+    openStatement(parser, ifNode);
 
-    if (entry->next == NULL)
+    if (!hasNext(parser, &token))
     {
-        fprintf(stderr, ERR_EXPECTED_EXPRESSION_AFTER_IF, entry->token->row, entry->token->column);
+        Position position = tokenPosition(parser->lexer, &token);
+        fprintf(stderr, ERR_EXPECTED_EXPRESSION_AFTER_IF, position.row, position.column);
         freeNode(ifNode);
         exit(EXIT_FAILURE);
     }
 
-    *currentEntry = entry->next;
-    entry = *currentEntry;
+    advance(parser);
+    token = peek(parser, 0);
 
-    ASTNode *conditionNode = parseExpression(table, currentEntry);
+    ASTNode *conditionNode = parseExpression(parser);
     ifNode->left = conditionNode;
-    entry = *currentEntry;
+    token = peek(parser, 0);
 
-    if (entry->token->type != RESERVED_WORD || strcmp(entry->token->word, RESERVED_WORD_THEN) != 0)
+    if (token.atom != KEYWORD_THEN)
     {
-        fprintf(stderr, ERR_EXPECTED_THEN, entry->token->row, entry->token->column);
+        Position position = tokenPosition(parser->lexer, &token);
+        fprintf(stderr, ERR_EXPECTED_THEN, position.row, position.column);
         freeNode(ifNode);
         exit(EXIT_FAILURE);
     }
 
-    *currentEntry = entry->next;
-    entry = *currentEntry;
+    advance(parser);
+    token = peek(parser, 0);
 
-    ASTNode *thenNode = parseStatement(table, currentEntry);
+    ASTNode *thenNode = parseStatement(parser);
     ifNode->right = thenNode;
-    entry = *currentEntry;
+    token = peek(parser, 0);
 
-    if (entry && entry->token->type == RESERVED_WORD && strcmp(entry->token->word, RESERVED_WORD_ELSE) == 0)
+    if (token.type != END_OF_FILE && token.atom == KEYWORD_ELSE)
     {
-        *currentEntry = entry->next;
-        entry = *currentEntry;
+        advance(parser);
+        token = peek(parser, 0);
 
-        ASTNode *elseNode = parseStatement(table, currentEntry);
-        ASTNode *elseBranchNode = createNode(RESERVED_WORD, RESERVED_WORD_ELSE);
+        ASTNode *elseNode = parseStatement(parser);
+        ASTNode *elseBranchNode = createNode(RESERVED_WORD, RESERVED_WORD_ELSE, strlen(RESERVED_WORD_ELSE));
         elseBranchNode->left = ifNode->right;
         elseBranchNode->right = elseNode;
         ifNode->right = elseBranchNode;
     }
 
+    closeStatement(parser, ifNode);
+
     return ifNode;
 }
 
-ASTNode *parseRepetitive(Table *table, Entry **currentEntry)
+ASTNode *parseRepetitive(Parser *parser)
 {
-    Entry *entry = *currentEntry;
+    Token token = peek(parser, 0);
 
-    if (entry->token->type != RESERVED_WORD || strcmp(entry->token->word, RESERVED_WORD_WHILE) != 0)
+    if (token.atom != KEYWORD_WHILE)
     {
-        fprintf(stderr, ERR_EXPECTED_WHILE, entry->token->row, entry->token->column);
+        Position position = tokenPosition(parser->lexer, &token);
+        fprintf(stderr, ERR_EXPECTED_WHILE, position.row, position.column);
         exit(EXIT_FAILURE);
     }
 
-    ASTNode *whileNode = createNode(entry->token->type, entry->token->word);
+    ASTNode *whileNode = createTokenNode(parser, &token);
+    openStatement(parser, whileNode);
 
-    if (entry->next == NULL)
+    if (!hasNext(parser, &token))
     {
-        fprintf(stderr, ERR_EXPECTED_EXPRESSION_AFTER_WHILE, entry->token->row, entry->token->column);
+        Position position = tokenPosition(parser->lexer, &token);
+        fprintf(stderr, ERR_EXPECTED_EXPRESSION_AFTER_WHILE, position.row, position.column);
         freeNode(whileNode);
         exit(EXIT_FAILURE);
     }
 
-    *currentEntry = entry->next;
-    entry = *currentEntry;
+    advance(parser);
+    token = peek(parser, 0);
 
-    ASTNode *conditionNode = parseExpression(table, currentEntry);
+    ASTNode *conditionNode = parseExpression(parser);
     whileNode->left = conditionNode;
-    entry = *currentEntry;
+    token = peek(parser, 0);
 
-    if (entry->token->type != RESERVED_WORD || strcmp(entry->token->word, RESERVED_WORD_DO) != 0)
+    if (token.atom != KEYWORD_DO)
     {
-        fprintf(stderr, ERR_EXPECTED_DO, entry->token->row, entry->token->column);
+        Position position = tokenPosition(parser->lexer, &token);
+        fprintf(stderr, ERR_EXPECTED_DO, position.row, position.column);
         freeNode(whileNode);
         exit(EXIT_FAILURE);
     }
 
-    if (entry->next == NULL)
+    if (!hasNext(parser, &token))
     {
-        fprintf(stderr, ERR_EXPECTED_STATEMENT_AFTER_DO, entry->token->row, entry->token->column);
+        Position position = tokenPosition(parser->lexer, &token);
+        fprintf(stderr, ERR_EXPECTED_STATEMENT_AFTER_DO, position.row, position.column);
         freeNode(whileNode);
         exit(EXIT_FAILURE);
     }
 
-    *currentEntry = entry->next;
-    entry = *currentEntry;
+    advance(parser);
+    token = peek(parser, 0);
 
-    ASTNode *doNode = parseStatement(table, currentEntry);
+    ASTNode *doNode = parseStatement(parser);
     whileNode->right = doNode;
+    closeStatement(parser, whileNode);
 
     return whileNode;
 }
 
-ASTNode *parseFactor(Table *table, Entry **currentEntry)
+ASTNode *parseFactor(Parser *parser)
 {
-    Entry *entry = *currentEntry;
+    Token token = peek(parser, 0);
     ASTNode *factorNode = NULL;
 
-    if (entry->token->type == NUMBER)
+    if (token.type == NUMBER)
     {
-        if (!isValidNumber(entry->token->word))
+        if (!isValidNumber(tokenLexeme(parser->lexer, &token), token.length))
         {
-            fprintf(stderr, ERR_INVALID_NUMBER, entry->token->word, entry->token->row, entry->token->column);
+            Position position = tokenPosition(parser->lexer, &token);
+            fprintf(stderr, ERR_INVALID_NUMBER, (int)token.length, tokenLexeme(parser->lexer, &token), position.row, position.column);
             exit(EXIT_FAILURE);
         }
-        factorNode = createNode(entry->token->type, entry->token->word);
+        factorNode = createTokenNode(parser, &token);
 
-        if (entry->next == NULL)
+        if (!hasNext(parser, &token))
         {
-            fprintf(stderr, ERR_EXPECTED_EXPRESSION_OR_SEMICOLON, entry->token->row, entry->token->column);
+            Position position = tokenPosition(parser->lexer, &token);
+            fprintf(stderr, ERR_EXPECTED_EXPRESSION_OR_SEMICOLON, position.row, position.column);
             freeNode(factorNode);
             exit(EXIT_FAILURE);
         }
 
-        *currentEntry = entry->next;
+        advance(parser);
     }
-    else if (entry->token->type == IDENTIFIER)
+    else if (token.type == IDENTIFIER)
     {
-        factorNode = createNode(entry->token->type, entry->token->word);
-        *currentEntry = entry->next;
+        factorNode = createTokenNode(parser, &token);
+        advance(parser);
     }
-    else if (strcmp(entry->token->word, SYMBOL_OPA) == 0)
+    else if (token.atom == ATOM_OPA)
     {
-        if (entry->next == NULL)
+        if (!hasNext(parser, &token))
         {
-            fprintf(stderr, ERR_EXPECTED_EXPRESSION_AFTER_OPEN_PAREN, entry->token->row, entry->token->column);
+            Position position = tokenPosition(parser->lexer, &token);
+            fprintf(stderr, ERR_EXPECTED_EXPRESSION_AFTER_OPEN_PAREN, position.row, position.column);
             freeNode(factorNode);
             exit(EXIT_FAILURE);
         }
 
-        *currentEntry = entry->next;
-        factorNode = parseExpression(table, currentEntry);
-        entry = *currentEntry;
-
-        if (strcmp(entry->token->word, SYMBOL_OPA) == 0)
-        {
-            factorNode = parseExpression(table, currentEntry);
-            *currentEntry = entry->next;
-            entry = *currentEntry;
-        }
+        advance(parser);
+        factorNode = parseExpression(parser);
+        token = peek(parser, 0);
 
-        if (entry == NULL || strcmp(entry->token->word, SYMBOL_CPA) != 0)
+        if (token.type == END_OF_FILE || token.atom != ATOM_CPA)
         {
-            fprintf(stderr, ERR_EXPECTED_CLOSE_PAREN, entry->token->row, entry->token->column);
+            Position position = tokenPosition(parser->lexer, &token);
+            fprintf(stderr, ERR_EXPECTED_CLOSE_PAREN, position.row, position.column);
             freeNode(factorNode);
             exit(EXIT_FAILURE);
         }
 
-        if (entry->next == NULL)
+        if (!hasNext(parser, &token))
         {
-            fprintf(stderr, ERR_EXPECTED_EXPRESSION_OR_SEMICOLON, entry->token->row, entry->token->column);
+            Position position = tokenPosition(parser->lexer, &token);
+            fprintf(stderr, ERR_EXPECTED_EXPRESSION_OR_SEMICOLON, position.row, position.column);
             freeNode(factorNode);
             exit(EXIT_FAILURE);
         }
 
-        *currentEntry = entry->next;
+        advance(parser);
     }
     else
     {
-        fprintf(stderr, ERR_UNEXPECTED_TOKEN, entry->token->word, entry->token->row, entry->token->column);
+        Position position = tokenPosition(parser->lexer, &token);
+        fprintf(stderr, ERR_UNEXPECTED_TOKEN, (int)token.length, tokenLexeme(parser->lexer, &token), position.row, position.column);
         exit(EXIT_FAILURE);
     }
 
     return factorNode;
 }
 
-ASTNode *parseTerm(Table *table, Entry **currentEntry)
+ASTNode *parseTerm(Parser *parser)
 {
-    ASTNode *termNode = parseFactor(table, currentEntry);
-    Entry *entry = *currentEntry;
+    ASTNode *termNode = parseFactor(parser);
+    Token token = peek(parser, 0);
 
-    while (entry && (strcmp(entry->token->word, OPERATOR_MUL) == 0 || strcmp(entry->token->word, OPERATOR_DIV) == 0))
+    while (token.type != END_OF_FILE && (token.atom == ATOM_MUL || token.atom == ATOM_DIV))
     {
-        ASTNode *operatorNode = createNode(entry->token->type, entry->token->word);
+        ASTNode *operatorNode = createTokenNode(parser, &token);
 
-        if (entry->next == NULL)
+        if (!hasNext(parser, &token))
         {
-            fprintf(stderr, ERR_EXPECTED_FACTOR_AFTER_OPERATOR, entry->token->word, entry->token->row, entry->token->column);
+            Position position = tokenPosition(parser->lexer, &token);
+            fprintf(stderr, ERR_EXPECTED_FACTOR_AFTER_OPERATOR, (int)token.length, tokenLexeme(parser->lexer, &token), position.row, position.column);
             freeNode(termNode);
             freeNode(operatorNode);
             exit(EXIT_FAILURE);
         }
 
-        *currentEntry = entry->next;
-        entry = *currentEntry;
+        advance(parser);
+        token = peek(parser, 0);
 
-        ASTNode *rightFactor = parseFactor(table, currentEntry);
+        ASTNode *rightFactor = parseFactor(parser);
 
         operatorNode->left = termNode;
         operatorNode->right = rightFactor;
         termNode = operatorNode;
-        entry = *currentEntry;
+        token = peek(parser, 0);
     }
 
     return termNode;
 }
 
-ASTNode *parseSimpleExpression(Table *table, Entry **currentEntry)
+ASTNode *parseSimpleExpression(Parser *parser)
 {
-    Entry *entry = *currentEntry;
+    Token token = peek(parser, 0);
     ASTNode *simpleExprNode = NULL;
 
-    if (entry->token->type == OPERATOR && (strcmp(entry->token->word, OPERATOR_SUM) == 0 || strcmp(entry->token->word, OPERATOR_SUB) == 0))
+    if (token.type == OPERATOR && (token.atom == ATOM_SUM || token.atom == ATOM_SUB))
     {
-        simpleExprNode = createNode(entry->token->type, entry->token->word);
+        simpleExprNode = createTokenNode(parser, &token);
 
-        if (entry->next == NULL)
+        if (!hasNext(parser, &token))
         {
-            fprintf(stderr, ERR_EXPECTED_TERM_AFTER_OPERATOR, entry->token->word, entry->token->row, entry->token->column);
+            Position position = tokenPosition(parser->lexer, &token);
+            fprintf(stderr, ERR_EXPECTED_TERM_AFTER_OPERATOR, (int)token.length, tokenLexeme(parser->lexer, &token), position.row, position.column);
             freeNode(simpleExprNode);
             exit(EXIT_FAILURE);
         }
 
-        *currentEntry = entry->next;
-        entry = *currentEntry;
+        advance(parser);
+        token = peek(parser, 0);
     }
 
-    ASTNode *termNode = parseTerm(table, currentEntry);
+    ASTNode *termNode = parseTerm(parser);
     if (simpleExprNode)
     {
         simpleExprNode->left = termNode;
@@ -303,58 +464,60 @@ ASTNode *parseSimpleExpression(Table *table, Entry **currentEntry)
         simpleExprNode = termNode;
     }
 
-    entry = *currentEntry;
+    token = peek(parser, 0);
 
-    while (entry && (strcmp(entry->token->word, OPERATOR_SUM) == 0 || strcmp(entry->token->word, OPERATOR_SUB) == 0))
+    while (token.type != END_OF_FILE && (token.atom == ATOM_SUM || token.atom == ATOM_SUB))
     {
-        ASTNode *operatorNode = createNode(entry->token->type, entry->token->word);
+        ASTNode *operatorNode = createTokenNode(parser, &token);
 
-        if (entry->next == NULL)
+        if (!hasNext(parser, &token))
         {
-            fprintf(stderr, ERR_EXPECTED_TERM_AFTER_OPERATOR, entry->token->word, entry->token->row, entry->token->column);
+            Position position = tokenPosition(parser->lexer, &token);
+            fprintf(stderr, ERR_EXPECTED_TERM_AFTER_OPERATOR, (int)token.length, tokenLexeme(parser->lexer, &token), position.row, position.column);
             freeNode(simpleExprNode);
             freeNode(operatorNode);
             exit(EXIT_FAILURE);
         }
 
-        *currentEntry = entry->next;
-        entry = *currentEntry;
+        advance(parser);
+        token = peek(parser, 0);
 
-        ASTNode *rightTermNode = parseTerm(table, currentEntry);
+        ASTNode *rightTermNode = parseTerm(parser);
         operatorNode->left = simpleExprNode;
         operatorNode->right = rightTermNode;
         simpleExprNode = operatorNode;
-        entry = *currentEntry;
+        token = peek(parser, 0);
     }
 
     return simpleExprNode;
 }
 
-ASTNode *parseExpression(Table *table, Entry **currentEntry)
+ASTNode *parseExpression(Parser *parser)
 {
-    ASTNode *expressionNode = parseSimpleExpression(table, currentEntry);
-    Entry *entry = *currentEntry;
-
-    if (entry && (strcmp(entry->token->word, "=") == 0 || strcmp(entry->token->word, "<>") == 0 ||
-                  strcmp(entry->token->word, "<") == 0 || strcmp(entry->token->word, "<=") == 0 ||
-                  strcmp(entry->token->word, ">") == 0 || strcmp(entry->token->word, ">=") == 0 ||
-                  strcmp(entry->token->word, "and") == 0 || strcmp(entry->token->word, "or") == 0 ||
-                  strcmp(entry->token->word, "not") == 0))
+    ASTNode *expressionNode = parseSimpleExpression(parser);
+    Token token = peek(parser, 0);
+
+    if (token.type != END_OF_FILE && (token.atom == ATOM_EQU || token.atom == ATOM_NE ||
+                  token.atom == ATOM_LT || token.atom == ATOM_LE ||
+                  token.atom == ATOM_GT || token.atom == ATOM_GE ||
+                  token.atom == KEYWORD_AND || token.atom == KEYWORD_OR ||
+                  token.atom == KEYWORD_NOT))
     {
-        ASTNode *relationNode = createNode(entry->token->type, entry->token->word);
+        ASTNode *relationNode = createTokenNode(parser, &token);
 
-        if (entry->next == NULL)
+        if (!hasNext(parser, &token))
         {
-            fprintf(stderr, ERR_EXPECTED_EXPRESSION_AFTER_OPERATOR, entry->token->word, entry->token->row, entry->token->column);
+            Position position = tokenPosition(parser->lexer, &token);
+            fprintf(stderr, ERR_EXPECTED_EXPRESSION_AFTER_OPERATOR, (int)token.length, tokenLexeme(parser->lexer, &token), position.row, position.column);
             freeNode(expressionNode);
             freeNode(relationNode);
             exit(EXIT_FAILURE);
         }
 
-        *currentEntry = entry->next;
-        entry = *currentEntry;
+        advance(parser);
+        token = peek(parser, 0);
 
-        ASTNode *rightExprNode = parseSimpleExpression(table, currentEntry);
+        ASTNode *rightExprNode = parseSimpleExpression(parser);
         relationNode->left = expressionNode;
         relationNode->right = rightExprNode;
         expressionNode = relationNode;
@@ -363,187 +526,240 @@ ASTNode *parseExpression(Table *table, Entry **currentEntry)
     return expressionNode;
 }
 
-ASTNode *parseAssignment(Table *table, Entry **currentEntry)
+ASTNode *parseAssignment(Parser *parser)
 {
-    Entry *entry = *currentEntry;
+    Token token = peek(parser, 0);
 
-    if (entry->token->type != IDENTIFIER)
+    if (token.type != IDENTIFIER)
     {
-        fprintf(stderr, ERR_EXPECTED_IDENTIFIER, entry->token->row, entry->token->column);
+        Position position = tokenPosition(parser->lexer, &token);
+        fprintf(stderr, ERR_EXPECTED_IDENTIFIER, position.row, position.column);
         exit(EXIT_FAILURE);
     }
 
-    ASTNode *assignmentNode = createNode(OPERATOR, OPERATOR_ASSIGNMENT);
-    ASTNode *idNode = createNode(entry->token->type, entry->token->word);
+    ASTNode *assignmentNode = createNode(OPERATOR, OPERATOR_ASSIGNMENT, strlen(OPERATOR_ASSIGNMENT));
+    openStatement(parser, assignmentNode);
+
+    ASTNode *idNode = createTokenNode(parser, &token);
     assignmentNode->left = idNode;
 
-    if (entry->next == NULL)
+    if (!hasNext(parser, &token))
     {
-        fprintf(stderr, ERR_EXPECTED_ASSIGNMENT_OPERATOR, entry->token->row, entry->token->column);
+        Position position = tokenPosition(parser->lexer, &token);
+        fprintf(stderr, ERR_EXPECTED_ASSIGNMENT_OPERATOR, position.row, position.column);
         freeNode(assignmentNode);
         exit(EXIT_FAILURE);
     }
 
-    *currentEntry = entry->next;
-    entry = *currentEntry;
+    advance(parser);
+    token = peek(parser, 0);
 
-    if (entry == NULL || strcmp(entry->token->word, OPERATOR_ASSIGNMENT) != 0)
+    if (token.type == END_OF_FILE || token.atom != ATOM_ASSIGNMENT)
     {
-        fprintf(stderr, ERR_EXPECTED_ASSIGNMENT_OPERATOR, entry->token->row, entry->token->column);
+        Position position = tokenPosition(parser->lexer, &token);
+        fprintf(stderr, ERR_EXPECTED_ASSIGNMENT_OPERATOR, position.row, position.column);
         freeNode(assignmentNode);
         exit(EXIT_FAILURE);
     }
 
-    if (entry->next == NULL)
+    if (!hasNext(parser, &token))
     {
-        fprintf(stderr, ERR_EXPECTED_EXPRESSION_AFTER_ASSIGNMENT, entry->token->row, entry->token->column);
+        Position position = tokenPosition(parser->lexer, &token);
+        fprintf(stderr, ERR_EXPECTED_EXPRESSION_AFTER_ASSIGNMENT, position.row, position.column);
         freeNode(assignmentNode);
         exit(EXIT_FAILURE);
     }
 
-    *currentEntry = entry->next;
-    entry = *currentEntry;
+    advance(parser);
+    token = peek(parser, 0);
 
-    if (entry == NULL)
+    if (token.type == END_OF_FILE)
     {
-        fprintf(stderr, ERR_EXPECTED_EXPRESSION_AFTER_ASSIGNMENT, entry->token->row, entry->token->column);
+        Position position = tokenPosition(parser->lexer, &token);
+        fprintf(stderr, ERR_EXPECTED_EXPRESSION_AFTER_ASSIGNMENT, position.row, position.column);
         freeNode(assignmentNode);
         exit(EXIT_FAILURE);
     }
 
-    ASTNode *exprNode = parseExpression(table, currentEntry);
+    ASTNode *exprNode = parseExpression(parser);
     assignmentNode->right = exprNode;
-    entry = *currentEntry;
+    token = peek(parser, 0);
 
-    if (entry == NULL || strcmp(entry->token->word, SYMBOL_SEM) != 0)
+    if (token.type == END_OF_FILE || token.atom != ATOM_SEM)
     {
-        fprintf(stderr, ERR_UNEXPECTED_TOKEN, entry->token->word, entry->token->row, entry->token->column);
+        Position position = tokenPosition(parser->lexer, &token);
+        fprintf(stderr, ERR_UNEXPECTED_TOKEN, (int)token.length, tokenLexeme(parser->lexer, &token), position.row, position.column);
         freeNode(assignmentNode);
         exit(EXIT_FAILURE);
     }
 
-    *currentEntry = entry->next;
+    advance(parser);
+    closeStatement(parser, assignmentNode);
 
     return assignmentNode;
 }
 
-ASTNode *parseStatement(Table *table, Entry **currentEntry)
+ASTNode *parseStatement(Parser *parser)
 {
-    Entry *entry = *currentEntry;
+    Token token = peek(parser, 0);
 
-    if (entry->token->type == IDENTIFIER)
+    if (token.type == IDENTIFIER)
+    {
+        return parseAssignment(parser);
+    }
+    else if (token.atom == KEYWORD_VAR)
     {
-        return parseAssignment(table, currentEntry);
+        return parseVarDeclaration(parser);
     }
-    else if (entry->token->type == RESERVED_WORD && strcmp(entry->token->word, RESERVED_WORD_VAR) == 0)
+    else if (token.atom == KEYWORD_BEGIN)
     {
-        return parseVarDeclaration(table, currentEntry);
+        return parseCompoundStatement(parser);
     }
-    else if (entry->token->type == RESERVED_WORD && strcmp(entry->token->word, RESERVED_WORD_BEGIN) == 0)
+    else if (token.atom == KEYWORD_IF)
     {
-        return parseCompoundStatement(table, currentEntry);
+        return parseConditional(parser);
     }
-    else if (entry->token->type == RESERVED_WORD && strcmp(entry->token->word, RESERVED_WORD_IF) == 0)
+    else if (token.atom == KEYWORD_WHILE)
     {
-        return parseConditional(table, currentEntry);
+        return parseRepetitive(parser);
     }
-    else if (entry->token->type == RESERVED_WORD && strcmp(entry->token->word, RESERVED_WORD_WHILE) == 0)
+    else if (token.atom == ATOM_SEM || token.atom == KEYWORD_END || token.atom == KEYWORD_ELSE)
     {
-        return parseRepetitive(table, currentEntry);
+        // empty statement:
+        return NULL;
     }
+
+    Position position = tokenPosition(parser->lexer, &token);
+    fprintf(stderr, ERR_UNEXPECTED_TOKEN, (int)token.length, tokenLexeme(parser->lexer, &token), position.row, position.column);
+    exit(EXIT_FAILURE);
 }
 
-ASTNode *parseCompoundStatement(Table *table, Entry **currentEntry)
+// parses one statement of a block with the ';' that may follow it:
+static ASTNode *parseCompoundItem(Parser *parser)
 {
-    Entry *entry = *currentEntry;
+    ASTNode *stmtNode = parseStatement(parser);
+    Token token = peek(parser, 0);
 
-    if (entry->token->type != RESERVED_WORD || strcmp(entry->token->word, RESERVED_WORD_BEGIN) != 0)
+    // an empty statement consumes nothing, so only a separator or the
+    // end of the block may follow it here:
+    if (stmtNode == NULL && token.atom != ATOM_SEM && token.atom != KEYWORD_END)
     {
-        fprintf(stderr, ERR_EXPECTED_BEGIN, entry->token->row, entry->token->column);
+        Position position = tokenPosition(parser->lexer, &token);
+        fprintf(stderr, ERR_UNEXPECTED_TOKEN, (int)token.length, tokenLexeme(parser->lexer, &token), position.row, position.column);
         exit(EXIT_FAILURE);
     }
 
-    ASTNode *compoundStmtNode = createNode(entry->token->type, entry->token->word);
+    // statements that do not end with their own ';' are separated by one:
+    if (token.atom == ATOM_SEM)
+    {
+        advance(parser);
+        token = peek(parser, 0);
+    }
 
-    if (entry->next == NULL)
+    if (token.atom != KEYWORD_END && !hasNext(parser, &token))
     {
-        fprintf(stderr, ERR_EXPECTED_STATEMENT_AFTER_BEGIN, entry->token->row, entry->token->column);
+        Position position = tokenPosition(parser->lexer, &token);
+        fprintf(stderr, ERR_EXPECTED_END, position.row, position.column);
         exit(EXIT_FAILURE);
     }
 
-    *currentEntry = entry->next;
-    entry = *currentEntry;
+    // a syntax check keeps memory bounded by the nesting depth:
+    if (!parser->keepTree)
+    {
+        freeNode(stmtNode);
+        return NULL;
+    }
+
+    return stmtNode;
+}
+
+ASTNode *parseCompoundStatement(Parser *parser)
+{
+    Token token = peek(parser, 0);
+
+    if (token.atom != KEYWORD_BEGIN)
+    {
+        Position position = tokenPosition(parser->lexer, &token);
+        fprintf(stderr, ERR_EXPECTED_BEGIN, position.row, position.column);
+        exit(EXIT_FAILURE);
+    }
+
+    ASTNode *compoundStmtNode = createTokenNode(parser, &token);
+    openStatement(parser, compoundStmtNode);
+
+    if (!hasNext(parser, &token))
+    {
+        Position position = tokenPosition(parser->lexer, &token);
+        fprintf(stderr, ERR_EXPECTED_STATEMENT_AFTER_BEGIN, position.row, position.column);
+        exit(EXIT_FAILURE);
+    }
+
+    advance(parser);
+    token = peek(parser, 0);
 
-    ASTNode *stmtListNode = NULL;
     ASTNode *lastStmtNode = NULL;
 
-    while (entry != NULL && strcmp(entry->token->word, RESERVED_WORD_END) != 0)
+    // the statements of the block are chained through their next node:
+    while (token.type != END_OF_FILE && token.atom != KEYWORD_END)
     {
-        ASTNode *stmtNode = parseStatement(table, currentEntry);
-        entry = *currentEntry;
+        ASTNode *stmtNode = parseCompoundItem(parser);
+        token = peek(parser, 0);
 
-        if (stmtListNode == NULL)
-        {
-            stmtListNode = stmtNode;
-        }
-        else
+        if (stmtNode == NULL)
         {
-            lastStmtNode->right = stmtNode;
+            continue;
         }
-        lastStmtNode = stmtNode;
-
-        if (entry->token->type == RESERVED_WORD && strcmp(entry->token->word, RESERVED_WORD_END) == 0)
+        else if (lastStmtNode == NULL)
         {
-            break;
+            compoundStmtNode->left = stmtNode;
         }
         else
         {
-            if (entry->next == NULL)
-            {
-                fprintf(stderr, ERR_EXPECTED_END, entry->token->row, entry->token->column);
-                exit(EXIT_FAILURE);
-            }
+            lastStmtNode->next = stmtNode;
         }
+        lastStmtNode = stmtNode;
     }
 
-    compoundStmtNode->left = stmtListNode;
-    *currentEntry = entry->next;
+    advance(parser);
+    closeStatement(parser, compoundStmtNode);
 
     return compoundStmtNode;
 }
 
-ASTNode *parseIdentifierList(Table *table, Entry **currentEntry)
+ASTNode *parseIdentifierList(Parser *parser)
 {
-    Entry *entry = *currentEntry;
-    ASTNode *idListNode = createNode(entry->token->type, entry->token->word);
+    Token token = peek(parser, 0);
+    ASTNode *idListNode = createTokenNode(parser, &token);
 
-    while (entry && entry->token->type == IDENTIFIER)
+    while (token.type != END_OF_FILE && token.type == IDENTIFIER)
     {
-        ASTNode *idNode = createNode(entry->token->type, entry->token->word);
+        ASTNode *idNode = createTokenNode(parser, &token);
         idListNode->right = idNode;
         idListNode = idNode;
 
-        if (entry->next == NULL)
+        if (!hasNext(parser, &token))
         {
-            fprintf(stderr, ERR_EXPECTED_COMMA_OR_COLON, entry->token->row, entry->token->column);
+            Position position = tokenPosition(parser->lexer, &token);
+            fprintf(stderr, ERR_EXPECTED_COMMA_OR_COLON, position.row, position.column);
             freeNode(idListNode);
             exit(EXIT_FAILURE);
         }
 
-        *currentEntry = entry->next;
-        entry = *currentEntry;
+        advance(parser);
+        token = peek(parser, 0);
 
-        if (entry && strcmp(entry->token->word, SYMBOL_COM) == 0)
+        if (token.type != END_OF_FILE && token.atom == ATOM_COM)
         {
-            if (entry->next == NULL || entry->next->token->type != IDENTIFIER)
+            if (!hasNext(parser, &token) || peek(parser, 1).type != IDENTIFIER)
             {
-                fprintf(stderr, ERR_EXPECTED_IDENTIFIER_AFTER_COMMA, entry->token->row, entry->token->column);
+                Position position = tokenPosition(parser->lexer, &token);
+                fprintf(stderr, ERR_EXPECTED_IDENTIFIER_AFTER_COMMA, position.row, position.column);
                 freeNode(idListNode);
                 exit(EXIT_FAILURE);
             }
 
-            *currentEntry = entry->next;
-            entry = *currentEntry;
+            advance(parser);
+            token = peek(parser, 0);
         }
         else
         {
@@ -554,77 +770,84 @@ ASTNode *parseIdentifierList(Table *table, Entry **currentEntry)
     return idListNode;
 }
 
-ASTNode *parseDeclaration(Table *table, Entry **currentEntry)
+ASTNode *parseDeclaration(Parser *parser)
 {
-    Entry *entry = *currentEntry;
-    ASTNode *declNode = createNode(entry->token->type, entry->token->word);
+    Token token = peek(parser, 0);
+    ASTNode *declNode = createTokenNode(parser, &token);
 
-    ASTNode *idListNode = parseIdentifierList(table, currentEntry);
+    ASTNode *idListNode = parseIdentifierList(parser);
     declNode->left = idListNode;
-    entry = *currentEntry;
+    token = peek(parser, 0);
 
-    if (strcmp(entry->token->word, SYMBOL_COLON) != 0)
+    if (token.atom != ATOM_COLON)
     {
-        fprintf(stderr, ERR_EXPECTED_COLON_OR_COMMA, entry->token->row, entry->token->column);
+        Position position = tokenPosition(parser->lexer, &token);
+        fprintf(stderr, ERR_EXPECTED_COLON_OR_COMMA, position.row, position.column);
         freeNode(declNode);
         exit(EXIT_FAILURE);
     }
 
-    if (entry->next == NULL)
+    if (!hasNext(parser, &token))
     {
-        fprintf(stderr, ERR_EXPECTED_TYPE_AFTER_COLON, entry->token->row, entry->token->column);
+        Position position = tokenPosition(parser->lexer, &token);
+        fprintf(stderr, ERR_EXPECTED_TYPE_AFTER_COLON, position.row, position.column);
         exit(EXIT_FAILURE);
     }
 
-    *currentEntry = entry->next;
-    entry = *currentEntry;
+    advance(parser);
+    token = peek(parser, 0);
 
-    if (entry->token->type != RESERVED_TYPE)
+    if (token.type != RESERVED_TYPE)
     {
-        fprintf(stderr, ERR_EXPECTED_TYPE_AFTER_COLON, entry->token->row, entry->token->column);
+        Position position = tokenPosition(parser->lexer, &token);
+        fprintf(stderr, ERR_EXPECTED_TYPE_AFTER_COLON, position.row, position.column);
         freeNode(declNode);
         exit(EXIT_FAILURE);
     }
 
-    ASTNode *typeNode = createNode(entry->token->type, entry->token->word);
+    ASTNode *typeNode = createTokenNode(parser, &token);
     declNode->right = typeNode;
 
-    if (entry->next == NULL || strcmp(entry->next->token->word, SYMBOL_SEM) != 0)
+    if (!hasNext(parser, &token) || peek(parser, 1).atom != ATOM_SEM)
     {
-        fprintf(stderr, ERR_EXPECTED_SEMICOLON, entry->token->row, entry->token->column);
+        Position position = tokenPosition(parser->lexer, &token);
+        fprintf(stderr, ERR_EXPECTED_SEMICOLON, position.row, position.column);
         freeNode(declNode);
         exit(EXIT_FAILURE);
     }
 
-    *currentEntry = entry->next;
+    advance(parser);
 
     return declNode;
 }
 
-ASTNode *parseVarDeclaration(Table *table, Entry **currentEntry)
+ASTNode *parseVarDeclaration(Parser *parser)
 {
-    Entry *entry = *currentEntry;
-    ASTNode *varDeclNode = createNode(entry->token->type, entry->token->word);
+    Token token = peek(parser, 0);
+    ASTNode *varDeclNode = createTokenNode(parser, &token);
+    openStatement(parser, varDeclNode);
 
-    while (entry && strcmp(entry->token->word, RESERVED_WORD_VAR) == 0)
+    while (token.type != END_OF_FILE && token.atom == KEYWORD_VAR)
     {
-        if (entry->next == NULL)
+        if (!hasNext(parser, &token))
         {
-            fprintf(stderr, ERR_EXPECTED_IDENTIFIER_AFTER_VAR, entry->token->row, entry->token->column);
+            Position position = tokenPosition(parser->lexer, &token);
+            fprintf(stderr, ERR_EXPECTED_IDENTIFIER_AFTER_VAR, position.row, position.column);
             exit(EXIT_FAILURE);
         }
 
-        *currentEntry = entry->next;
-        entry = *currentEntry;
+        advance(parser);
+        token = peek(parser, 0);
 
-        ASTNode *declNode = parseDeclaration(table, currentEntry);
+        ASTNode *declNode = parseDeclaration(parser);
+        freeNode(varDeclNode->right);
         varDeclNode->right = declNode;
-        entry = *currentEntry;
+        token = peek(parser, 0);
 
-        if (entry && strcmp(entry->token->word, SYMBOL_SEM) == 0)
+        if (token.type != END_OF_FILE && token.atom == ATOM_SEM)
         {
-            *currentEntry = entry->next;
-            entry = *currentEntry;
+            advance(parser);
+            token = peek(parser, 0);
         }
         else
         {
@@ -632,111 +855,336 @@ ASTNode *parseVarDeclaration(Table *table, Entry **currentEntry)
         }
     }
 
+    closeStatement(parser, varDeclNode);
+
     return varDeclNode;
 }
 
-ASTNode *parseBlock(Table *table, Entry **currentEntry)
+ASTNode *parseBlock(Parser *parser)
 {
-    Entry *entry = *currentEntry;
-    ASTNode *blockNode = createNode(entry->token->type, entry->token->word);
+    Token token = peek(parser, 0);
+    ASTNode *blockNode = createTokenNode(parser, &token);
 
-    ASTNode *varDeclNode = parseVarDeclaration(table, currentEntry);
+    ASTNode *varDeclNode = parseVarDeclaration(parser);
     blockNode->left = varDeclNode;
 
-    ASTNode *compoundStmtNode = parseCompoundStatement(table, currentEntry);
+    ASTNode *compoundStmtNode = parseCompoundStatement(parser);
     blockNode->right = compoundStmtNode;
 
     return blockNode;
 }
 
-ASTNode *parseProgram(Table *table, Entry **currentEntry)
+ASTNode *parseProgram(Parser *parser)
 {
-    Entry *entry = *currentEntry;
+    Token token = peek(parser, 0);
 
-    if (entry->token->type != RESERVED_WORD || strcmp(entry->token->word, RESERVED_WORD_PROGRAM) != 0)
+    if (token.atom != KEYWORD_PROGRAM)
     {
-        fprintf(stderr, ERR_EXPECTED_PROGRAM, entry->token->row, entry->token->column);
+        Position position = tokenPosition(parser->lexer, &token);
+        fprintf(stderr, ERR_EXPECTED_PROGRAM, position.row, position.column);
         exit(EXIT_FAILURE);
     }
 
-    ASTNode *programNode = createNode(entry->token->type, entry->token->word);
+    ASTNode *programNode = createTokenNode(parser, &token);
+    openStatement(parser, programNode);
 
-    if (entry->next == NULL)
+    if (!hasNext(parser, &token))
     {
-        fprintf(stderr, ERR_EXPECTED_IDENTIFIER_AFTER_PROGRAM, entry->token->row, entry->token->column);
+        Position position = tokenPosition(parser->lexer, &token);
+        fprintf(stderr, ERR_EXPECTED_IDENTIFIER_AFTER_PROGRAM, position.row, position.column);
         freeNode(programNode);
         exit(EXIT_FAILURE);
     }
 
-    *currentEntry = entry->next;
-    entry = *currentEntry;
+    advance(parser);
+    token = peek(parser, 0);
 
-    if (entry->token->type != IDENTIFIER)
+    if (token.type != IDENTIFIER)
     {
-        fprintf(stderr, ERR_EXPECTED_IDENTIFIER_AFTER_PROGRAM, entry->token->row, entry->token->column);
+        Position position = tokenPosition(parser->lexer, &token);
+        fprintf(stderr, ERR_EXPECTED_IDENTIFIER_AFTER_PROGRAM, position.row, position.column);
         freeNode(programNode);
         exit(EXIT_FAILURE);
     }
 
-    ASTNode *idNode = createNode(entry->token->type, entry->token->word);
+    ASTNode *idNode = createTokenNode(parser, &token);
     programNode->right = idNode;
 
-    if (entry->next == NULL)
+    if (!hasNext(parser, &token))
     {
-        fprintf(stderr, ERR_EXPECTED_SEMICOLON, entry->token->row, entry->token->column);
+        Position position = tokenPosition(parser->lexer, &token);
+        fprintf(stderr, ERR_EXPECTED_SEMICOLON, position.row, position.column);
         freeNode(programNode);
         exit(EXIT_FAILURE);
     }
 
-    *currentEntry = entry->next;
-    entry = *currentEntry;
+    advance(parser);
+    token = peek(parser, 0);
 
-    ASTNode *semicolonNode = createNode(entry->token->type, entry->token->word);
+    ASTNode *semicolonNode = createTokenNode(parser, &token);
     idNode->right = semicolonNode;
 
-    if (strcmp(entry->token->word, SYMBOL_SEM) != 0)
+    if (token.atom != ATOM_SEM)
     {
-        fprintf(stderr, ERR_EXPECTED_SEMICOLON, entry->token->row, entry->token->column);
+        Position position = tokenPosition(parser->lexer, &token);
+        fprintf(stderr, ERR_EXPECTED_SEMICOLON, position.row, position.column);
         freeNode(programNode);
         exit(EXIT_FAILURE);
     }
 
-    if (entry->next == NULL)
+    if (!hasNext(parser, &token))
     {
-        fprintf(stderr, ERR_EXPECTED_BLOCK_AFTER_PROGRAM_DECLARATION, entry->token->row, entry->token->column);
+        Position position = tokenPosition(parser->lexer, &token);
+        fprintf(stderr, ERR_EXPECTED_BLOCK_AFTER_PROGRAM_DECLARATION, position.row, position.column);
         freeNode(programNode);
         exit(EXIT_FAILURE);
     }
 
-    *currentEntry = entry->next;
-    entry = *currentEntry;
+    advance(parser);
+    token = peek(parser, 0);
 
-    ASTNode *blockNode = parseBlock(table, currentEntry);
+    ASTNode *blockNode = parseBlock(parser);
     programNode->left = blockNode;
-    entry = *currentEntry;
+    token = peek(parser, 0);
 
-    if (strcmp(entry->token->word, SYMBOL_DOT) != 0)
+    if (token.atom != ATOM_DOT)
     {
-        fprintf(stderr, ERR_EXPECTED_DOT_AFTER_PROGRAM_BLOCK, entry->token->row, entry->token->column);
+        Position position = tokenPosition(parser->lexer, &token);
+        fprintf(stderr, ERR_EXPECTED_DOT_AFTER_PROGRAM_BLOCK, position.row, position.column);
         freeNode(programNode);
         exit(EXIT_FAILURE);
     }
 
-    *currentEntry = entry->next;
+    advance(parser);
+    closeStatement(parser, programNode);
 
     return programNode;
 }
 
-ASTNode *parseTokens(Table *table)
+ASTNode *parseTokens(LexerContext *lexer)
+{
+    if (lexer->table->tokens->count == 0)
+    {
+        fprintf(stderr, ERR_NO_TOKENS_TO_PARSE);
+        exit(EXIT_FAILURE);
+    }
+
+    Parser parser;
+    initParser(&parser, lexer->table->tokens, lexer, 1);
+
+    ASTNode *root = parseProgram(&parser);
+
+    return root;
+}
+
+ASTNode *parseSource(LexerContext *lexer, int keepTree)
 {
-    if (table->entryCount == 0)
+    Parser parser;
+    initParser(&parser, NULL, lexer, keepTree);
+
+    if (peek(&parser, 0).type == END_OF_FILE)
     {
         fprintf(stderr, ERR_NO_TOKENS_TO_PARSE);
         exit(EXIT_FAILURE);
     }
 
-    Entry *entry = table->entries[0];
-    ASTNode *root = parseProgram(table, &entry);
+    ASTNode *root = parseProgram(&parser);
 
     return root;
-}
\ No newline at end of file
+}
+static int isCompound(const ASTNode *node)
+{
+    return node->atom == KEYWORD_BEGIN;
+}
+
+// returns the statement directly inside the compound that holds the node, or
+// the compound itself for its own 'begin', 'end' and separators:
+static ASTNode *itemOf(ASTNode *node, const ASTNode *compound)
+{
+    while (node != NULL && node != compound && node->parent != compound)
+        node = node->parent;
+
+    return node;
+}
+
+static ASTNode *itemAt(const TokenStream *tokens, size_t index, const ASTNode *compound)
+{
+    return itemOf((ASTNode *)tokenTag(tokens, index), compound);
+}
+
+// returns the innermost compound statement enclosing both nodes, or NULL if
+// only the program does:
+static ASTNode *enclosingCompound(ASTNode *left, ASTNode *right)
+{
+    for (ASTNode *node = left; node != NULL; node = node->parent)
+    {
+        if (!isCompound(node))
+            continue;
+
+        for (ASTNode *other = right; other != NULL; other = other->parent)
+        {
+            if (other == node)
+                return node;
+        }
+    }
+
+    return NULL;
+}
+
+// moves the start of a range of tokens back to where the parser is at the
+// start of a statement of the compound: after its 'begin' or a separator. A
+// statement that ends without one may still take the next token, as 'if'
+// does with 'else', so it is parsed again too:
+static size_t itemsStart(const TokenStream *tokens, const ASTNode *compound, size_t start)
+{
+    while (start > 0)
+    {
+        ASTNode *item = itemAt(tokens, start - 1, compound);
+
+        if (item == compound)
+            break;
+
+        while (start > 0 && itemAt(tokens, start - 1, compound) == item)
+            start--;
+    }
+
+    return start;
+}
+
+// moves the end of a range of tokens forward past the statement of the
+// compound it falls in and the separator after it:
+static size_t itemsEnd(const TokenStream *tokens, const ASTNode *compound, size_t end)
+{
+    ASTNode *item = itemAt(tokens, end, compound);
+
+    if (item != compound)
+    {
+        while (end < tokens->count && itemAt(tokens, end, compound) == item)
+            end++;
+
+        if (end == tokens->count || itemAt(tokens, end, compound) != compound)
+            return end;
+    }
+
+    return streamToken(tokens, end).atom == KEYWORD_END ? end : end + 1;
+}
+
+// returns the statement of the compound nearest to a token, looking from
+// it in the given direction past separators, or NULL at 'begin' or 'end':
+static ASTNode *itemNear(const TokenStream *tokens, size_t index, const ASTNode *compound, int step)
+{
+    ASTNode *item;
+
+    while ((item = itemAt(tokens, index, compound)) == compound && streamToken(tokens, index).atom == ATOM_SEM)
+        index += step;
+
+    return item == compound ? NULL : item;
+}
+
+// parses again the statements of a compound held by a range of tokens and
+// puts them in place of the old ones. Returns zero, leaving the tree and the
+// tags as they were, if the statements parsed do not end with the range:
+static int reparseItems(LexerContext *lexer, ASTNode *compound, size_t start, size_t end)
+{
+    TokenStream *tokens = lexer->table->tokens;
+    ASTNode *items = NULL, *lastItem = NULL;
+    Parser parser;
+
+    initParser(&parser, tokens, lexer, 1);
+    parser.position = start;
+    parser.statement = compound;
+    startTags(&parser);
+
+    Token token = peek(&parser, 0);
+
+    while (parser.position < end && token.type != END_OF_FILE && token.atom != KEYWORD_END)
+    {
+        ASTNode *stmtNode = parseCompoundItem(&parser);
+        token = peek(&parser, 0);
+
+        if (stmtNode == NULL)
+            continue;
+        else if (lastItem == NULL)
+            items = stmtNode;
+        else
+            lastItem->next = stmtNode;
+        lastItem = stmtNode;
+    }
+
+    if (parser.position != end)
+    {
+        endTags(&parser, tokens, 0);
+        freeNode(items);
+        return 0;
+    }
+
+    // the old statements lie between the ones left on either side:
+    ASTNode *before = itemNear(tokens, start - 1, compound, -1);
+    ASTNode *after = itemNear(tokens, end, compound, 1);
+    ASTNode **link = before != NULL ? &before->next : &compound->left;
+    ASTNode *old = *link;
+
+    if (lastItem != NULL)
+    {
+        *link = items;
+        lastItem->next = after;
+    }
+    else
+    {
+        *link = after;
+    }
+
+    while (old != after)
+    {
+        ASTNode *next = old->next;
+        old->next = NULL;
+        freeNode(old);
+        old = next;
+    }
+
+    endTags(&parser, tokens, 1);
+
+    return 1;
+}
+
+ASTNode *parseEdit(LexerContext *lexer, ASTNode *root, size_t first, size_t count)
+{
+    TokenStream *tokens = lexer->table->tokens;
+    ASTNode *compound = NULL;
+    size_t start = first, end = first + count;
+
+    if (root != NULL && start > 0 && end < tokens->count)
+        compound = enclosingCompound((ASTNode *)tokenTag(tokens, start - 1), (ASTNode *)tokenTag(tokens, end));
+
+    // the smallest run of statements around the edit is tried first, then
+    // the statement holding their compound, and so on outwards:
+    for (; compound != NULL && end < tokens->count; compound = enclosingCompound(compound->parent, compound->parent))
+    {
+        start = itemsStart(tokens, compound, start);
+        end = itemsEnd(tokens, compound, end);
+
+        if (end < tokens->count && reparseItems(lexer, compound, start, end))
+            return root;
+    }
+
+    if (tokens->count == 0)
+    {
+        fprintf(stderr, ERR_NO_TOKENS_TO_PARSE);
+        exit(EXIT_FAILURE);
+    }
+
+    Parser parser;
+    initParser(&parser, tokens, lexer, 1);
+    startTags(&parser);
+
+    ASTNode *tree = parseProgram(&parser);
+
+    // tokens after the program are not part of any statement:
+    for (size_t index = parser.position; index < tokens->count; index++)
+        setTokenTag(tokens, index, NULL);
+
+    endTags(&parser, tokens, 1);
+    freeNode(root);
+
+    return tree;
+}
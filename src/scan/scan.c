@@ -0,0 +1,547 @@
+#include <stddef.h>
+#include <stdatomic.h>
+
+#include "../includes/scan.h"
+#include "../includes/tokens.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+// lexers on several threads may ask for the kernels at once:
+static _Atomic(const ScanKernels *) selected = NULL;
+
+//====================================================================================================================================================//
+
+// scalar kernels, also used for the tails shorter than a vector:
+
+static inline int isIdentifierChar(unsigned char ch)
+{
+	return (unsigned char)((ch | 0x20) - 'a') < 26 || (unsigned char)(ch - '0') < 10 || ch == SMB_UNDER;
+}
+
+static const char *spacesScalar(const char *cursor, const char *limit)
+{
+	while (cursor < limit && (*cursor == SPACE || *cursor == TAB || *cursor == NEW_LINE))
+		cursor++;
+
+	return cursor;
+}
+
+static const char *identifierScalar(const char *cursor, const char *limit)
+{
+	while (cursor < limit && isIdentifierChar((unsigned char)*cursor))
+		cursor++;
+
+	return cursor;
+}
+
+static const char *digitsScalar(const char *cursor, const char *limit)
+{
+	while (cursor < limit && (unsigned char)(*cursor - '0') < 10)
+		cursor++;
+
+	return cursor;
+}
+
+static const char *stringScalar(const char *cursor, const char *limit)
+{
+	while (cursor < limit && *cursor != SMB_SQT && *cursor != SMB_DQT && *cursor != NEW_LINE)
+		cursor++;
+
+	return cursor;
+}
+
+static size_t lineStartsScalar(const char *cursor, const char *limit, size_t offset, size_t *starts)
+{
+	size_t count = 0;
+
+	for (const char *from = cursor; cursor < limit; cursor++)
+	{
+		if (*cursor == NEW_LINE)
+			starts[count++] = offset + (size_t)(cursor - from) + 1;
+	}
+
+	return count;
+}
+
+static const char *asciiScalar(const char *cursor, const char *limit)
+{
+	while (cursor < limit && (unsigned char)*cursor < 0x80)
+		cursor++;
+
+	return cursor;
+}
+
+// the end of the multi-byte sequence at the cursor, or the cursor itself if
+// the sequence is cut short, overlong, a surrogate or past U+10FFFF:
+static inline const char *utf8Sequence(const char *cursor, const char *limit)
+{
+	unsigned char lead = (unsigned char)*cursor;
+	size_t length = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : 2;
+	unsigned int code = lead & (0x7F >> length), least = length == 4 ? 0x10000 : length == 3 ? 0x800 : 0x80;
+
+	if (lead < 0xC2 || lead > 0xF4 || (size_t)(limit - cursor) < length)
+		return cursor;
+
+	for (size_t index = 1; index < length; index++)
+	{
+		if (((unsigned char)cursor[index] & 0xC0) != 0x80)
+			return cursor;
+
+		code = code << 6 | ((unsigned char)cursor[index] & 0x3F);
+	}
+
+	if (code < least || code > 0x10FFFF || (code >= 0xD800 && code <= 0xDFFF))
+		return cursor;
+
+	return cursor + length;
+}
+
+static const char *utf8Scalar(const char *cursor, const char *limit)
+{
+	while ((cursor = asciiScalar(cursor, limit)) < limit)
+	{
+		const char *end = utf8Sequence(cursor, limit);
+
+		if (end == cursor)
+			break;
+
+		cursor = end;
+	}
+
+	return cursor;
+}
+
+static const ScanKernels scalarKernels = {"scalar", spacesScalar, identifierScalar, digitsScalar, stringScalar, lineStartsScalar, asciiScalar, utf8Scalar};
+
+//====================================================================================================================================================//
+
+#ifdef SCAN_X86
+
+// each vector kernel builds a bit mask of the bytes that belong to the run;
+// the first zero bit is the end of the run. Ranges are tested with unsigned
+// saturation: (x - lo) fits in [0, hi - lo] exactly when min(x - lo, hi - lo)
+// leaves it unchanged.
+
+#define SCAN_SSE2_TARGET __attribute__((target("sse2")))
+
+SCAN_SSE2_TARGET static inline __m128i inRange128(__m128i v, char lo, char hi)
+{
+	__m128i shifted = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+	return _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8((char)(hi - lo))), shifted);
+}
+
+SCAN_SSE2_TARGET static const char *spacesSSE2(const char *cursor, const char *limit)
+{
+	while (limit - cursor >= 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *)cursor);
+		__m128i lines = _mm_cmpeq_epi8(v, _mm_set1_epi8(NEW_LINE));
+		__m128i blanks = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(SPACE)), _mm_cmpeq_epi8(v, _mm_set1_epi8(TAB)));
+		unsigned int run = ~(unsigned int)_mm_movemask_epi8(_mm_or_si128(lines, blanks)) & 0xFFFF;
+
+		if (run)
+			return cursor + __builtin_ctz(run);
+
+		cursor += 16;
+	}
+
+	return spacesScalar(cursor, limit);
+}
+
+SCAN_SSE2_TARGET static const char *identifierSSE2(const char *cursor, const char *limit)
+{
+	while (limit - cursor >= 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *)cursor);
+		__m128i letters = inRange128(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z');
+		__m128i digits = inRange128(v, '0', '9');
+		__m128i under = _mm_cmpeq_epi8(v, _mm_set1_epi8(SMB_UNDER));
+		unsigned int run = ~(unsigned int)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(letters, digits), under)) & 0xFFFF;
+
+		if (run)
+			return cursor + __builtin_ctz(run);
+
+		cursor += 16;
+	}
+
+	return identifierScalar(cursor, limit);
+}
+
+SCAN_SSE2_TARGET static const char *digitsSSE2(const char *cursor, const char *limit)
+{
+	while (limit - cursor >= 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *)cursor);
+		unsigned int run = ~(unsigned int)_mm_movemask_epi8(inRange128(v, '0', '9')) & 0xFFFF;
+
+		if (run)
+			return cursor + __builtin_ctz(run);
+
+		cursor += 16;
+	}
+
+	return digitsScalar(cursor, limit);
+}
+
+SCAN_SSE2_TARGET static const char *stringSSE2(const char *cursor, const char *limit)
+{
+	while (limit - cursor >= 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *)cursor);
+		__m128i quotes = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(SMB_SQT)), _mm_cmpeq_epi8(v, _mm_set1_epi8(SMB_DQT)));
+		unsigned int stop = (unsigned int)_mm_movemask_epi8(_mm_or_si128(quotes, _mm_cmpeq_epi8(v, _mm_set1_epi8(NEW_LINE))));
+
+		if (stop)
+			return cursor + __builtin_ctz(stop);
+
+		cursor += 16;
+	}
+
+	return stringScalar(cursor, limit);
+}
+
+// every new line found in a vector is written out by walking its bits:
+SCAN_SSE2_TARGET static size_t lineStartsSSE2(const char *cursor, const char *limit, size_t offset, size_t *starts)
+{
+	const char *from = cursor;
+	size_t count = 0;
+
+	while (limit - cursor >= 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *)cursor);
+		unsigned int found = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(NEW_LINE)));
+		size_t at = offset + (size_t)(cursor - from) + 1;
+
+		for (; found; found &= found - 1)
+			starts[count++] = at + (size_t)__builtin_ctz(found);
+
+		cursor += 16;
+	}
+
+	return count + lineStartsScalar(cursor, limit, offset + (size_t)(cursor - from), starts + count);
+}
+
+SCAN_SSE2_TARGET static const char *asciiSSE2(const char *cursor, const char *limit)
+{
+	while (limit - cursor >= 16)
+	{
+		unsigned int wide = (unsigned int)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)cursor));
+
+		if (wide)
+			return cursor + __builtin_ctz(wide);
+
+		cursor += 16;
+	}
+
+	return asciiScalar(cursor, limit);
+}
+
+// ASCII runs are skipped a vector at a time; only the multi-byte sequences
+// are decoded one by one:
+SCAN_SSE2_TARGET static const char *utf8SSE2(const char *cursor, const char *limit)
+{
+	while ((cursor = asciiSSE2(cursor, limit)) < limit)
+	{
+		const char *end = utf8Sequence(cursor, limit);
+
+		if (end == cursor)
+			break;
+
+		cursor = end;
+	}
+
+	return cursor;
+}
+
+static const ScanKernels sse2Kernels = {"sse2", spacesSSE2, identifierSSE2, digitsSSE2, stringSSE2, lineStartsSSE2, asciiSSE2, utf8SSE2};
+
+#define SCAN_AVX2_TARGET __attribute__((target("avx2")))
+
+SCAN_AVX2_TARGET static inline __m256i inRange256(__m256i v, char lo, char hi)
+{
+	__m256i shifted = _mm256_sub_epi8(v, _mm256_set1_epi8(lo));
+	return _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8((char)(hi - lo))), shifted);
+}
+
+SCAN_AVX2_TARGET static const char *spacesAVX2(const char *cursor, const char *limit)
+{
+	while (limit - cursor >= 32)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i *)cursor);
+		__m256i lines = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(NEW_LINE));
+		__m256i blanks = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(SPACE)), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(TAB)));
+		unsigned int run = ~(unsigned int)_mm256_movemask_epi8(_mm256_or_si256(lines, blanks));
+
+		if (run)
+			return cursor + __builtin_ctz(run);
+
+		cursor += 32;
+	}
+
+	return spacesSSE2(cursor, limit);
+}
+
+SCAN_AVX2_TARGET static const char *identifierAVX2(const char *cursor, const char *limit)
+{
+	while (limit - cursor >= 32)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i *)cursor);
+		__m256i letters = inRange256(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z');
+		__m256i digits = inRange256(v, '0', '9');
+		__m256i under = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(SMB_UNDER));
+		unsigned int run = ~(unsigned int)_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(letters, digits), under));
+
+		if (run)
+			return cursor + __builtin_ctz(run);
+
+		cursor += 32;
+	}
+
+	return identifierSSE2(cursor, limit);
+}
+
+SCAN_AVX2_TARGET static const char *digitsAVX2(const char *cursor, const char *limit)
+{
+	while (limit - cursor >= 32)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i *)cursor);
+		unsigned int run = ~(unsigned int)_mm256_movemask_epi8(inRange256(v, '0', '9'));
+
+		if (run)
+			return cursor + __builtin_ctz(run);
+
+		cursor += 32;
+	}
+
+	return digitsSSE2(cursor, limit);
+}
+
+SCAN_AVX2_TARGET static const char *stringAVX2(const char *cursor, const char *limit)
+{
+	while (limit - cursor >= 32)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i *)cursor);
+		__m256i quotes = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(SMB_SQT)), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(SMB_DQT)));
+		unsigned int stop = (unsigned int)_mm256_movemask_epi8(_mm256_or_si256(quotes, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(NEW_LINE))));
+
+		if (stop)
+			return cursor + __builtin_ctz(stop);
+
+		cursor += 32;
+	}
+
+	return stringSSE2(cursor, limit);
+}
+
+SCAN_AVX2_TARGET static size_t lineStartsAVX2(const char *cursor, const char *limit, size_t offset, size_t *starts)
+{
+	const char *from = cursor;
+	size_t count = 0;
+
+	while (limit - cursor >= 32)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i *)cursor);
+		unsigned int found = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(NEW_LINE)));
+		size_t at = offset + (size_t)(cursor - from) + 1;
+
+		for (; found; found &= found - 1)
+			starts[count++] = at + (size_t)__builtin_ctz(found);
+
+		cursor += 32;
+	}
+
+	return count + lineStartsSSE2(cursor, limit, offset + (size_t)(cursor - from), starts + count);
+}
+
+SCAN_AVX2_TARGET static const char *asciiAVX2(const char *cursor, const char *limit)
+{
+	while (limit - cursor >= 32)
+	{
+		unsigned int wide = (unsigned int)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i *)cursor));
+
+		if (wide)
+			return cursor + __builtin_ctz(wide);
+
+		cursor += 32;
+	}
+
+	return asciiSSE2(cursor, limit);
+}
+
+// the UTF-8 validation of Keiser and Lemire: three tables map the high and
+// low nibbles of each byte and the high nibble of the byte after it to the
+// errors the pair may take part in, and the pair is malformed when all three
+// agree on one. Sequences of three and four bytes are checked by requiring a
+// continuation exactly where the lead bytes two and three places back expect
+// one:
+#define UTF8_TOO_SHORT (1 << 0)
+#define UTF8_TOO_LONG (1 << 1)
+#define UTF8_OVERLONG_3 (1 << 2)
+#define UTF8_TOO_LARGE (1 << 3)
+#define UTF8_SURROGATE (1 << 4)
+#define UTF8_OVERLONG_2 (1 << 5)
+#define UTF8_TOO_LARGE_1000 (1 << 6)
+#define UTF8_OVERLONG_4 (1 << 6)
+#define UTF8_TWO_CONTINUATIONS (1 << 7)
+#define UTF8_CARRY (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTINUATIONS)
+
+#define UTF8_TABLE(...) _mm256_setr_epi8(__VA_ARGS__, __VA_ARGS__)
+
+// the input shifted by count bytes, with the end of the previous block
+// coming in:
+#define UTF8_PREVIOUS(input, previous, count) _mm256_alignr_epi8(input, _mm256_permute2x128_si256(previous, input, 0x21), 16 - (count))
+
+SCAN_AVX2_TARGET static inline __m256i utf8Errors(__m256i input, __m256i previous)
+{
+	const __m256i nibble = _mm256_set1_epi8(0x0F);
+	const __m256i byte1High = UTF8_TABLE(
+		UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+		UTF8_TWO_CONTINUATIONS, UTF8_TWO_CONTINUATIONS, UTF8_TWO_CONTINUATIONS, UTF8_TWO_CONTINUATIONS,
+		UTF8_TOO_SHORT | UTF8_OVERLONG_2, UTF8_TOO_SHORT, UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+		UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4);
+	const __m256i byte1Low = UTF8_TABLE(
+		UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4, UTF8_CARRY | UTF8_OVERLONG_2, UTF8_CARRY, UTF8_CARRY,
+		UTF8_CARRY | UTF8_TOO_LARGE, UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+		UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+		UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+		UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+		UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE, UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+		UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000);
+	const __m256i byte2High = UTF8_TABLE(
+		UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+		UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTINUATIONS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+		UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTINUATIONS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE,
+		UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTINUATIONS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+		UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTINUATIONS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+		UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT);
+
+	__m256i previous1 = UTF8_PREVIOUS(input, previous, 1);
+	__m256i special = _mm256_and_si256(_mm256_and_si256(_mm256_shuffle_epi8(byte1High, _mm256_and_si256(_mm256_srli_epi16(previous1, 4), nibble)),
+															_mm256_shuffle_epi8(byte1Low, _mm256_and_si256(previous1, nibble))),
+										 _mm256_shuffle_epi8(byte2High, _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble)));
+	__m256i third = _mm256_subs_epu8(UTF8_PREVIOUS(input, previous, 2), _mm256_set1_epi8((char)(0xE0 - 0x80)));
+	__m256i fourth = _mm256_subs_epu8(UTF8_PREVIOUS(input, previous, 3), _mm256_set1_epi8((char)(0xF0 - 0x80)));
+
+	return _mm256_xor_si256(_mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8((char)0x80)), special);
+}
+
+// a block boundary may fall inside a sequence, whose lead byte is at most
+// three bytes back; decoding resumes at the first byte there that is not a
+// continuation, which begins a character:
+static inline const char *sequenceStart(const char *from, const char *cursor)
+{
+	const char *start = cursor - from > 3 ? cursor - 3 : from;
+
+	while (start < cursor && ((unsigned char)*start & 0xC0) == 0x80)
+		start++;
+
+	return start;
+}
+
+// blocks are only checked for errors; the first malformed sequence of a
+// block that has one, and the tail shorter than a block, are found by the
+// SSE2 kernel:
+SCAN_AVX2_TARGET static const char *utf8AVX2(const char *cursor, const char *limit)
+{
+	const char *from = cursor;
+	const __m256i maxima = _mm256_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+											(char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1));
+	__m256i previous = _mm256_setzero_si256(), incomplete = _mm256_setzero_si256();
+
+	while (limit - cursor >= 32)
+	{
+		__m256i input = _mm256_loadu_si256((const __m256i *)cursor);
+		__m256i errors;
+
+		// an ASCII block can only be wrong by ending a sequence too soon:
+		if (_mm256_movemask_epi8(input) == 0)
+		{
+			errors = incomplete;
+			incomplete = _mm256_setzero_si256();
+		}
+		else
+		{
+			errors = utf8Errors(input, previous);
+			incomplete = _mm256_subs_epu8(input, maxima);
+		}
+
+		if (!_mm256_testz_si256(errors, errors))
+			return utf8SSE2(sequenceStart(from, cursor), limit);
+
+		previous = input;
+		cursor += 32;
+	}
+
+	return utf8SSE2(sequenceStart(from, cursor), limit);
+}
+
+static const ScanKernels avx2Kernels = {"avx2", spacesAVX2, identifierAVX2, digitsAVX2, stringAVX2, lineStartsAVX2, asciiAVX2, utf8AVX2};
+
+#endif
+
+//====================================================================================================================================================//
+
+const ScanKernels *getScanKernels(ScanLevel level)
+{
+#ifdef SCAN_X86
+	__builtin_cpu_init();
+#endif
+
+	switch (level)
+	{
+	case SCAN_SCALAR:
+		return &scalarKernels;
+
+#ifdef SCAN_X86
+	case SCAN_SSE2:
+		return __builtin_cpu_supports("sse2") ? &sse2Kernels : NULL;
+
+	case SCAN_AVX2:
+		return __builtin_cpu_supports("avx2") ? &avx2Kernels : NULL;
+
+	case SCAN_AUTO:
+		if (__builtin_cpu_supports("avx2"))
+			return &avx2Kernels;
+		if (__builtin_cpu_supports("sse2"))
+			return &sse2Kernels;
+		return &scalarKernels;
+#else
+	case SCAN_AUTO:
+		return &scalarKernels;
+#endif
+
+	default:
+		return NULL;
+	}
+}
+
+int selectScanKernels(ScanLevel level)
+{
+	const ScanKernels *kernels = getScanKernels(level);
+
+	if (kernels == NULL)
+		return 0;
+
+	atomic_store(&selected, kernels);
+	return 1;
+}
+
+const ScanKernels *activeScanKernels(void)
+{
+	const ScanKernels *kernels = atomic_load_explicit(&selected, memory_order_acquire);
+
+	if (kernels == NULL)
+	{
+		const ScanKernels *none = NULL;
+		kernels = getScanKernels(SCAN_AUTO);
+
+		// another thread may have picked them first:
+		if (!atomic_compare_exchange_strong(&selected, &none, kernels))
+			kernels = none;
+	}
+
+	return kernels;
+}
@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../includes/source.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+static int readSource(Source *source, const char *path);
+
+Source *openSource(const char *path)
+{
+	Source *source = (Source *)malloc(sizeof(Source));
+
+	if (source == NULL)
+		return NULL;
+
+	source->data = NULL;
+	source->size = 0;
+	source->mapped = 0;
+
+#ifndef _WIN32
+	int fd = open(path, O_RDONLY);
+
+	if (fd < 0)
+	{
+		free(source);
+		return NULL;
+	}
+
+	struct stat info;
+
+	if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+	{
+		void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (data != MAP_FAILED)
+		{
+#ifdef MADV_SEQUENTIAL
+			madvise(data, (size_t)info.st_size, MADV_SEQUENTIAL);
+#endif
+			source->data = (const char *)data;
+			source->size = (size_t)info.st_size;
+			source->mapped = 1;
+		}
+	}
+
+	close(fd);
+
+	if (source->mapped)
+		return source;
+#endif
+
+	if (!readSource(source, path))
+	{
+		free(source);
+		return NULL;
+	}
+
+	return source;
+}
+
+void closeSource(Source *source)
+{
+	if (source == NULL)
+		return;
+
+#ifndef _WIN32
+	if (source->mapped)
+		munmap((void *)source->data, source->size);
+	else
+#endif
+		free((void *)source->data);
+
+	free(source);
+}
+
+// fallback for files that cannot be mapped: one growing buffer filled with
+// large reads, so the lexer still sees the whole file at once:
+static int readSource(Source *source, const char *path)
+{
+	FILE *file = fopen(path, "r");
+
+	if (file == NULL)
+		return 0;
+
+	size_t capacity = 1 << 16, size = 0, count;
+	char *data = (char *)malloc(capacity);
+
+	while (data != NULL && (count = fread(data + size, 1, capacity - size, file)) > 0)
+	{
+		size += count;
+
+		if (size == capacity)
+		{
+			char *grown = (char *)realloc(data, capacity * 2);
+
+			if (grown == NULL)
+			{
+				free(data);
+				data = NULL;
+				break;
+			}
+
+			data = grown;
+			capacity *= 2;
+		}
+	}
+
+	fclose(file);
+
+	if (data == NULL)
+		return 0;
+
+	source->data = data;
+	source->size = size;
+	source->mapped = 0;
+
+	return 1;
+}
@@ -0,0 +1,477 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../includes/stream.h"
+#include "../includes/errors.h"
+
+static TokenChunk *addChunk(TokenStream *stream, size_t base);
+static TokenChunk *newChunk(size_t base);
+static void freeChunk(TokenChunk *chunk);
+static void reserveChunks(TokenStream *stream, size_t count);
+static size_t findChunk(const TokenStream *stream, size_t index, size_t *slot);
+static void spliceChunk(TokenChunk *chunk, size_t at, size_t removed, size_t kept, const TokenStream *replacement, ptrdiff_t offsetDelta);
+static void storeToken(TokenChunk *chunk, size_t slot, const Token *token, void *tag);
+static void setOffset(TokenChunk *chunk, size_t slot, size_t offset);
+static size_t offsetAt(const TokenStream *stream, size_t index);
+static size_t slotOffset(const TokenChunk *chunk, size_t slot);
+
+TokenStream *createTokenStream(void)
+{
+	TokenStream *stream = (TokenStream *)malloc(sizeof(TokenStream));
+
+	if (stream == NULL)
+	{
+		fprintf(stderr, ERR_MEMORY_ALLOCATION_FAILED);
+		exit(EXIT_FAILURE);
+	}
+
+	stream->chunks = NULL;
+	stream->starts = NULL;
+	stream->chunkCount = 0;
+	stream->chunkCapacity = 0;
+	stream->count = 0;
+	stream->dense = 1;
+
+	return stream;
+}
+
+void clearTokenStream(TokenStream *stream)
+{
+	for (size_t chunk = 0; chunk < stream->chunkCount; chunk++)
+		freeChunk(stream->chunks[chunk]);
+
+	stream->chunkCount = 0;
+	stream->count = 0;
+	stream->dense = 1;
+}
+
+void freeTokenStream(TokenStream *stream)
+{
+	if (stream == NULL)
+		return;
+
+	clearTokenStream(stream);
+	free(stream->chunks);
+	free(stream->starts);
+	free(stream);
+}
+
+size_t appendToken(TokenStream *stream, const Token *token)
+{
+	size_t index = stream->count;
+	size_t slot = stream->chunkCount > 0 ? index - stream->starts[stream->chunkCount - 1] : TOKEN_CHUNK_SIZE;
+	TokenChunk *chunk = slot < TOKEN_CHUNK_SIZE ? stream->chunks[stream->chunkCount - 1] : addChunk(stream, token->offset);
+
+	storeToken(chunk, slot & (TOKEN_CHUNK_SIZE - 1), token, NULL);
+	stream->count++;
+
+	return index;
+}
+
+size_t reserveTokens(TokenStream *stream, TokenStream *const *parts, size_t partCount)
+{
+	size_t first = stream->count, index = first;
+
+	// each new chunk is based at the offset of its first token, found in
+	// whichever part lands on the chunk boundary:
+	for (size_t part = 0; part < partCount; part++)
+	{
+		size_t end = index + parts[part]->count;
+		size_t boundary = (index + TOKEN_CHUNK_SIZE - 1) & ~(size_t)(TOKEN_CHUNK_SIZE - 1);
+
+		for (; boundary < end; boundary += TOKEN_CHUNK_SIZE)
+		{
+			addChunk(stream, offsetAt(parts[part], boundary - index));
+			stream->starts[stream->chunkCount - 1] = boundary;
+		}
+
+		index = end;
+	}
+
+	// offsets only grow, so the last token of a chunk tells whether any of
+	// them is out of reach of the base. The side array is allocated here, as
+	// copyTokens may run on several threads:
+	size_t partStart = first, part = 0;
+
+	for (size_t chunk = first >> TOKEN_CHUNK_BITS; index > first && chunk < stream->chunkCount; chunk++)
+	{
+		size_t last = ((chunk + 1) << TOKEN_CHUNK_BITS) < index ? ((chunk + 1) << TOKEN_CHUNK_BITS) - 1 : index - 1;
+
+		while (last >= partStart + parts[part]->count)
+			partStart += parts[part++]->count;
+
+		if (offsetAt(parts[part], last - partStart) - stream->chunks[chunk]->base >= UINT32_MAX && stream->chunks[chunk]->far == NULL)
+		{
+			stream->chunks[chunk]->far = (uint64_t *)malloc(TOKEN_CHUNK_SIZE * sizeof(uint64_t));
+
+			if (stream->chunks[chunk]->far == NULL)
+			{
+				fprintf(stderr, ERR_MEMORY_ALLOCATION_FAILED);
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+
+	stream->count = index;
+
+	return first;
+}
+
+void copyTokens(TokenStream *stream, size_t at, const TokenStream *part, const Atom *remap)
+{
+	for (size_t index = 0; index < part->count; index++)
+	{
+		const TokenChunk *from = part->chunks[index >> TOKEN_CHUNK_BITS];
+		TokenChunk *to = stream->chunks[(at + index) >> TOKEN_CHUNK_BITS];
+		size_t fromSlot = index & (TOKEN_CHUNK_SIZE - 1), toSlot = (at + index) & (TOKEN_CHUNK_SIZE - 1);
+
+		to->kind[toSlot] = from->kind[fromSlot];
+		setOffset(to, toSlot, offsetAt(part, index));
+		to->length[toSlot] = from->length[fromSlot];
+		to->atom[toSlot] = remap != NULL ? remap[from->atom[fromSlot]] : from->atom[fromSlot];
+	}
+}
+
+void spliceTokens(TokenStream *stream, size_t from, size_t removed, const TokenStream *replacement, ptrdiff_t offsetDelta)
+{
+	size_t end = from + removed;
+
+	if (stream->chunkCount == 0)
+	{
+		for (size_t index = 0; index < replacement->count; index++)
+		{
+			Token token = streamToken(replacement, index);
+			appendToken(stream, &token);
+		}
+
+		return;
+	}
+
+	size_t within;
+	size_t first = from < stream->count ? findChunk(stream, from, &within) : stream->chunkCount - 1;
+	size_t last = end > from ? findChunk(stream, end - 1, &within) : first;
+	size_t keepStart = stream->starts[first];
+	size_t keepEnd = last + 1 < stream->chunkCount ? stream->starts[last + 1] : stream->count;
+	size_t total = (from - keepStart) + replacement->count + (keepEnd - end);
+	size_t built = (total + TOKEN_CHUNK_SIZE - 1) >> TOKEN_CHUNK_BITS;
+	size_t replaced = last - first + 1;
+
+	// a range that still fits in its chunk is spliced in place, which only
+	// moves the tokens after it in that chunk:
+	if (first == last && total > 0 && total <= TOKEN_CHUNK_SIZE)
+	{
+		spliceChunk(stream->chunks[first], from - keepStart, removed, keepEnd - end, replacement, offsetDelta);
+	}
+	else
+	{
+		// otherwise the chunks holding the range are rebuilt from the tokens
+		// they keep before and after it, with the replacement in between:
+		TokenChunk **chunks = (TokenChunk **)malloc((built ? built : 1) * sizeof(TokenChunk *));
+
+		if (chunks == NULL)
+		{
+			fprintf(stderr, ERR_MEMORY_ALLOCATION_FAILED);
+			exit(EXIT_FAILURE);
+		}
+
+		for (size_t position = 0; position < total; position++)
+		{
+			Token token;
+			void *tag = NULL;
+
+			if (position < from - keepStart)
+			{
+				token = streamToken(stream, keepStart + position);
+				tag = tokenTag(stream, keepStart + position);
+			}
+			else if (position < from - keepStart + replacement->count)
+			{
+				token = streamToken(replacement, position - (from - keepStart));
+			}
+			else
+			{
+				size_t index = end + position - (from - keepStart + replacement->count);
+
+				token = streamToken(stream, index);
+				tag = tokenTag(stream, index);
+				token.offset += offsetDelta;
+			}
+
+			if ((position & (TOKEN_CHUNK_SIZE - 1)) == 0)
+				chunks[position >> TOKEN_CHUNK_BITS] = newChunk(token.offset);
+
+			storeToken(chunks[position >> TOKEN_CHUNK_BITS], position & (TOKEN_CHUNK_SIZE - 1), &token, tag);
+		}
+
+		for (size_t chunk = first; chunk <= last; chunk++)
+			freeChunk(stream->chunks[chunk]);
+
+		size_t tail = stream->chunkCount - last - 1;
+
+		reserveChunks(stream, stream->chunkCount - replaced + built);
+		memmove(stream->chunks + first + built, stream->chunks + last + 1, tail * sizeof(TokenChunk *));
+		memmove(stream->starts + first + built, stream->starts + last + 1, tail * sizeof(size_t));
+		memcpy(stream->chunks + first, chunks, built * sizeof(TokenChunk *));
+		free(chunks);
+	}
+
+	stream->chunkCount = stream->chunkCount - replaced + built;
+	stream->count = stream->count - removed + replacement->count;
+
+	for (size_t chunk = 0; chunk < built; chunk++)
+		stream->starts[first + chunk] = keepStart + (chunk << TOKEN_CHUNK_BITS);
+
+	// the chunks after the range only move:
+	for (size_t chunk = first + built; chunk < stream->chunkCount; chunk++)
+	{
+		TokenChunk *moved = stream->chunks[chunk];
+
+		stream->starts[chunk] = stream->starts[chunk] - removed + replacement->count;
+		moved->base += offsetDelta;
+
+		for (size_t slot = 0; moved->far != NULL && slot < TOKEN_CHUNK_SIZE; slot++)
+		{
+			if (moved->offset[slot] == UINT32_MAX)
+				moved->far[slot] += offsetDelta;
+		}
+	}
+
+	stream->dense = 1;
+
+	for (size_t chunk = 0; chunk + 1 < stream->chunkCount && stream->dense; chunk++)
+		stream->dense = stream->starts[chunk + 1] - stream->starts[chunk] == TOKEN_CHUNK_SIZE;
+}
+
+size_t findToken(const TokenStream *stream, size_t offset)
+{
+	size_t low = 0, high = stream->count;
+
+	while (low < high)
+	{
+		size_t middle = low + (high - low) / 2;
+
+		if (offsetAt(stream, middle) < offset)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	return low;
+}
+
+void setTokenTag(TokenStream *stream, size_t index, void *tag)
+{
+	size_t slot;
+	TokenChunk *owner = stream->chunks[findChunk(stream, index, &slot)];
+
+	if (owner->tag == NULL)
+	{
+		owner->tag = (void **)calloc(TOKEN_CHUNK_SIZE, sizeof(void *));
+
+		if (owner->tag == NULL)
+		{
+			fprintf(stderr, ERR_MEMORY_ALLOCATION_FAILED);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	owner->tag[slot] = tag;
+}
+
+void *tokenTag(const TokenStream *stream, size_t index)
+{
+	size_t slot;
+	const TokenChunk *owner = stream->chunks[findChunk(stream, index, &slot)];
+
+	return owner->tag != NULL ? owner->tag[slot] : NULL;
+}
+
+Token streamToken(const TokenStream *stream, size_t index)
+{
+	size_t slot;
+	const TokenChunk *owner = stream->chunks[findChunk(stream, index, &slot)];
+	Token token = createToken((TokenKind)owner->kind[slot], slotOffset(owner, slot), owner->length[slot]);
+
+	token.atom = owner->atom[slot];
+	token.index = index;
+
+	return token;
+}
+
+static TokenChunk *addChunk(TokenStream *stream, size_t base)
+{
+	reserveChunks(stream, stream->chunkCount + 1);
+
+	TokenChunk *chunk = newChunk(base);
+
+	stream->starts[stream->chunkCount] = stream->count;
+	stream->chunks[stream->chunkCount++] = chunk;
+
+	return chunk;
+}
+
+static TokenChunk *newChunk(size_t base)
+{
+	TokenChunk *chunk = (TokenChunk *)malloc(sizeof(TokenChunk));
+
+	if (chunk == NULL)
+	{
+		fprintf(stderr, ERR_MEMORY_ALLOCATION_FAILED);
+		exit(EXIT_FAILURE);
+	}
+
+	chunk->base = base;
+	chunk->far = NULL;
+	chunk->tag = NULL;
+
+	return chunk;
+}
+
+static void freeChunk(TokenChunk *chunk)
+{
+	free(chunk->far);
+	free(chunk->tag);
+	free(chunk);
+}
+
+static void reserveChunks(TokenStream *stream, size_t count)
+{
+	if (count <= stream->chunkCapacity)
+		return;
+
+	size_t capacity = stream->chunkCapacity ? stream->chunkCapacity : 16;
+
+	while (capacity < count)
+		capacity *= 2;
+
+	TokenChunk **chunks = (TokenChunk **)realloc(stream->chunks, capacity * sizeof(TokenChunk *));
+	size_t *starts = chunks != NULL ? (size_t *)realloc(stream->starts, capacity * sizeof(size_t)) : NULL;
+
+	if (chunks == NULL || starts == NULL)
+	{
+		fprintf(stderr, ERR_MEMORY_ALLOCATION_FAILED);
+		exit(EXIT_FAILURE);
+	}
+
+	stream->chunks = chunks;
+	stream->starts = starts;
+	stream->chunkCapacity = capacity;
+}
+
+// a shift while no splice left a chunk partially filled, a binary search on
+// the first index of each chunk otherwise:
+static size_t findChunk(const TokenStream *stream, size_t index, size_t *slot)
+{
+	if (stream->dense)
+	{
+		*slot = index & (TOKEN_CHUNK_SIZE - 1);
+		return index >> TOKEN_CHUNK_BITS;
+	}
+
+	size_t low = 0, high = stream->chunkCount - 1;
+
+	while (low < high)
+	{
+		size_t middle = low + (high - low + 1) / 2;
+
+		if (stream->starts[middle] <= index)
+			low = middle;
+		else
+			high = middle - 1;
+	}
+
+	*slot = index - stream->starts[low];
+	return low;
+}
+
+static void spliceChunk(TokenChunk *chunk, size_t at, size_t removed, size_t kept, const TokenStream *replacement, ptrdiff_t offsetDelta)
+{
+	size_t added = replacement->count, from = at + removed, to = at + added;
+	uint64_t base = chunk->base;
+
+	// a chunk is based at its first token, which may move back when it is
+	// replaced:
+	if (at == 0)
+		chunk->base = added > 0 ? offsetAt(replacement, 0) : slotOffset(chunk, from) + offsetDelta;
+
+	memmove(chunk->kind + to, chunk->kind + from, kept * sizeof(chunk->kind[0]));
+	memmove(chunk->offset + to, chunk->offset + from, kept * sizeof(chunk->offset[0]));
+	memmove(chunk->length + to, chunk->length + from, kept * sizeof(chunk->length[0]));
+	memmove(chunk->atom + to, chunk->atom + from, kept * sizeof(chunk->atom[0]));
+
+	if (chunk->far != NULL)
+		memmove(chunk->far + to, chunk->far + from, kept * sizeof(chunk->far[0]));
+
+	if (chunk->tag != NULL)
+		memmove(chunk->tag + to, chunk->tag + from, kept * sizeof(chunk->tag[0]));
+
+	for (size_t slot = to; slot < to + kept; slot++)
+		setOffset(chunk, slot, (chunk->offset[slot] == UINT32_MAX ? chunk->far[slot] : base + chunk->offset[slot]) + offsetDelta);
+
+	for (size_t index = 0; index < added; index++)
+	{
+		Token token = streamToken(replacement, index);
+		storeToken(chunk, at + index, &token, NULL);
+	}
+}
+
+static void storeToken(TokenChunk *chunk, size_t slot, const Token *token, void *tag)
+{
+	chunk->kind[slot] = (uint8_t)token->kind;
+	setOffset(chunk, slot, token->offset);
+	chunk->length[slot] = (uint32_t)token->length;
+	chunk->atom[slot] = token->atom;
+
+	if (tag != NULL || chunk->tag != NULL)
+	{
+		if (chunk->tag == NULL)
+		{
+			chunk->tag = (void **)calloc(TOKEN_CHUNK_SIZE, sizeof(void *));
+
+			if (chunk->tag == NULL)
+			{
+				fprintf(stderr, ERR_MEMORY_ALLOCATION_FAILED);
+				exit(EXIT_FAILURE);
+			}
+		}
+
+		chunk->tag[slot] = tag;
+	}
+}
+
+// sources larger than 4 GiB may put a token out of reach of the base; its
+// full offset then goes to a side array allocated on first need:
+static void setOffset(TokenChunk *chunk, size_t slot, size_t offset)
+{
+	if (offset - chunk->base < UINT32_MAX)
+	{
+		chunk->offset[slot] = (uint32_t)(offset - chunk->base);
+		return;
+	}
+
+	if (chunk->far == NULL)
+		chunk->far = (uint64_t *)malloc(TOKEN_CHUNK_SIZE * sizeof(uint64_t));
+
+	if (chunk->far == NULL)
+	{
+		fprintf(stderr, ERR_MEMORY_ALLOCATION_FAILED);
+		exit(EXIT_FAILURE);
+	}
+
+	chunk->offset[slot] = UINT32_MAX;
+	chunk->far[slot] = offset;
+}
+
+static size_t offsetAt(const TokenStream *stream, size_t index)
+{
+	size_t slot;
+	const TokenChunk *owner = stream->chunks[findChunk(stream, index, &slot)];
+
+	return slotOffset(owner, slot);
+}
+
+static size_t slotOffset(const TokenChunk *chunk, size_t slot)
+{
+	return chunk->offset[slot] == UINT32_MAX ? chunk->far[slot] : chunk->base + chunk->offset[slot];
+}
@@ -0,0 +1,9 @@
+program T_014;
+
+// variáveis do cálculo da média
+var soma, media: integer;
+
+begin
+    soma := 10; // não é um erro: comentários aceitam acentuação
+    media := 'Atenção: média não calculada'; soma := soma + 1;
+end.
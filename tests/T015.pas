@@ -0,0 +1,12 @@
+program T_015;
+
+{ comentários de bloco podem
+  ocupar várias linhas }
+var soma, fator: integer; (* contador *)
+
+begin
+    (* um comentário com * e ) no meio,
+       e com { chaves } dentro *)
+    soma := (10 + 2) * 3; { fim } fator := soma;
+    fator := fator * (soma); // fim da linha
+end.
@@ -2,7 +2,7 @@
 
 set dir=%~dp0
 
-cd %dir% && gcc ./src/lexer/lexer.c ./src/parser/parser.c ./src/main.c -o main.exe
+cd %dir% && gcc ./src/lexer/lexer.c ./src/parser/parser.c ./src/source/source.c ./src/scan/scan.c ./src/atoms/atoms.c ./src/stream/stream.c ./src/lines/lines.c ./src/document/document.c ./src/main.c -o main.exe -lpthread
 
 if %errorlevel% equ 0 (
     cls && start cmd /k main.exe --file ./tests/T007.pas